@@ -14,6 +14,18 @@ motor controls for door operations. The program also includes an
 interrupt service routine (ISR) for handling serial communication, 
 triggering specific actions based on received commands.
  
+Pin map:	Changed from the original board, which must be rewired to match.
+RB4, RB5	zone 0 up and down limit switches, moved from RD2/RD3 to
+		the interrupt-on-change pins so a limit stops the motor at once
+RD2, RD3	zone 1 lowering and raising motor relays (were the limits)
+RA0 (AN0)	zone 0 motor current sense
+RA1, RA2, RA3	zone 1 up and down limit switches and case sensor
+RE0		zone 1 door lock
+Unchanged: RB0 intruder, RB2/RB3 tray LEDs, RC0/RC3 and RC1/RC2 
+zone 0 H-bridge high and low sides (RC1/RC2 now PWM from CCP2/CCP1),
+RC7 tamper alarm, RD0 zone 0 door lock, RD4 password breach, RD5 
+remote access, RD6/RD7 USART2 to the fire detection system.
+ 
 -----------------------------------------------------------------------------*/
 // Use of AI / Cognitive Assistance software is not allowed in any exercise.
  
@@ -31,6 +43,7 @@ triggering specific actions based on received commands.
 #pragma config PBADEN	= OFF
 #pragma config LVP		= OFF
 #pragma config MCLRE	= EXTMCLR
+#pragma config CCP2MX	= PORTC1
  
 // Libraries ------------------------------------------------------------------
 #include <p18f45k22.h>
@@ -38,6 +51,9 @@ triggering specific actions based on received commands.
 #include <stdlib.h>
 #include <delays.h>
 #include <string.h>
+#include "nodeFrame.h"
+#include "nodePower.h"
+#include "nodeIsr.h"
  
 // Constants  -----------------------------------------------------------------
 #define TRUE		1	
@@ -51,12 +67,14 @@ triggering specific actions based on received commands.
  
  
 #define INTRUDER PORTBbits.RB0
-#define LMTUP PORTDbits.RD2
-#define LMTDWN PORTDbits.RD3
+#define LMTUP PORTBbits.RB4 // on interrupt-on-change pins
+#define LMTDWN PORTBbits.RB5
+#define ATTOP (!LMTUP) // limit switches pull low when reached
+#define ATBOTTOM (!LMTDWN)
  
-#define M1FWD LATCbits.LATC0
+#define M1FWD LATCbits.LATC0 // high side enables, switched statically
 #define M1REV LATCbits.LATC3
-#define M2FWD LATCbits.LATC1
+#define M2FWD LATCbits.LATC1 // low sides, driven by CCP2 and CCP1 as PWM
 #define M2REV LATCbits.LATC2
  
 #define REMOX PORTDbits.RD5
@@ -69,36 +87,295 @@ triggering specific actions based on received commands.
 #define DLOCK LATDbits.LATD0
  
 #define BUFSIZE 30
+#define RXSIZE 32 // receive ring size, a power of 2
+#define CMDBUCKETS 16 // command hash table size, a power of 2
+#define CMDMASK (CMDBUCKETS - 1)
+#define HEXBASE 16
+#define TRAY_STOPPED 0 // motors off, waiting for a demand
+#define TRAY_LOWERING 1 // securing the artifact
+#define TRAY_RAISING 2 // exposing the artifact
+#define TRAY_FAULT 3 // a travel timed out, motors off until the demand drops
+#define TRAY_DOWN 1 // setTray directions
+#define TRAY_UP 2
+#define LOWERTICKS 1500 // longest lowering travel (15s)
+#define TICKMS 10 // milliseconds per tick
+#define IOCFLAG INTCONbits.RBIF
+#define LIMITIOC 0x30 // RB4 and RB5 interrupt on change
+#define PWMPR 49 // 20kHz PWM from Timer4 at 1:1
+#define T4PWM 0x04 // Timer4 on, 1:1 prescale and postscale
+#define CCPTMR4 0x09 // CCP1 and CCP2 PWM timebase on Timer4
+#define CCPPWM 0x0C // CCP in PWM mode
+#define PWMMAX 200 // full duty, 4 * (PWMPR + 1)
+#define PWMSHIFT 2 // duty bits held in CCPxCON
+#define PWMLOW 0x03
+#define RAMPUP 8 // duty added per tick when starting (250ms to full)
+#define RAMPDOWN 10 // duty removed per tick when stopping (200ms to rest)
+#define LATBINS 10 // lockdown latency histogram bins
+#define LATSHIFT 5 // bin 0 takes latencies under 2^LATSHIFT us, each next bin doubles
+#define LAT_EDGE 0 // lockdown caused by an INT0 edge, stamped by the vector
+#define LAT_POLL 1 // lockdown caused by an input sampled by the ISR
+#define EDGECYCLES 4 // INT0 edge to the first vector instruction, worst case
+#define HSTSIZE 80 // longest $HST reply
+#define STSSIZE 40 // longest $STS reply
+#define IDX_INTRUDER 0x01 // decision index bits
+#define IDX_REMOX 0x02
+#define IDX_TALARM 0x04
+#define IDX_BREACH 0x08
+#define IDX_FIRE 0x10
+#define IDX_SERVICE 0x20
+#define DECISIONS 64 // every combination of the index bits
+#define DEC_SECURE 0x01 // lower the tray and lock the door
+#define DEC_UNLOCK 0x02 // unlock the door, never set with DEC_SECURE
+// RB0, RD5, RC7 and RD4 of one port snapshot shifted into the index bits
+#define PACKINDEX(b, c, d, fire, service) (((b) & 0x01) | (((d) >> 4) & IDX_REMOX) | \
+(((c) >> 5) & IDX_TALARM) | (((d) >> 1) & IDX_BREACH) | ((fire) ? IDX_FIRE : 0) | \
+((service) ? IDX_SERVICE : 0))
+// The interlock rules for one index, evaluated by the compiler for every row.
+// Each row holds one lock state: securing wins over unlocking.
+#define DECIDE(i) (((!((i) & IDX_INTRUDER) && !((i) & IDX_REMOX)) || \
+((i) & (IDX_TALARM | IDX_BREACH | IDX_FIRE))) ? DEC_SECURE : \
+((i) & (IDX_INTRUDER | IDX_SERVICE)) ? DEC_UNLOCK : 0)
+#define DECIDE4(i) DECIDE(i), DECIDE((i) + 1), DECIDE((i) + 2), DECIDE((i) + 3)
+#define DECIDE16(i) DECIDE4(i), DECIDE4((i) + 4), DECIDE4((i) + 8), DECIDE4((i) + 12)
+#define RAISETICKS 1500 // longest raising travel (15s)
+#define NOMWEIGHT 4 // a new travel time moves the nominal by 1/NOMWEIGHT
+#define STALLSHIFT 2 // a travel may run nominal/4...
+#define STALLGRACE 20 // ...plus 200ms over its learned nominal
+#define NOMFLOOR 100 // shortest nominal learned (1s), so a bad travel cannot arm a hair trigger
+#define ADCFLAG PIR1bits.ADIF
+#define ADCMASK 0x40 // ADIF in PIR1, ADIE in PIE1
+#define ADCAN0 0x01 // AN0 motor current sense, ADC on
+#define ADCTIMING 0xA9 // right justified, 12 Tad, Fosc/8
+#define T3SAMPLE 0x03 // Timer3 on, Fosc/4, 16 bit reads
+#define CCPTMR3 0x04 // CCP5 compare timebase on Timer3
+#define CCPTRIGGER 0x0B // CCP5 special event trigger, starts the ADC
+#define SAMPLEPERIOD 1000 // Timer3 counts per current sample (1kHz)
+#define CURRENTSHIFT 1 // a stall draws the learned running current plus a half...
+#define CURRENTGRACE 50 // ...plus 50 ADC counts
+#define STALLSAMPLES 50 // consecutive samples over stallLimit (50ms)
+#define FLT_TIME 1 // travel outlasted its learned nominal
+#define FLT_CURRENT 2 // motor current stayed over stallLimit
+#define RXMASK (RXSIZE - 1)
 #define RC1FLAG PIR1bits.RC1IF
-#define INTGON 0xC0
+#define INTGON 0xC0 // GIEH and GIEL
+#define INT0MASKF 0x02 // INT0IF in INTCON
+#define INT0MASKE 0x10 // INT0IE in INTCON
+#define TMR2MASK 0x02 // TMR2IF in PIR1, TMR2IE in PIE1
+#define RBMASKF 0x01 // RBIF in INTCON
+#define RBMASKE 0x08 // RBIE in INTCON
+#define RC2MASK 0x20 // RC2IF in PIR3, RC2IE in PIE3
+#define TX2MASK 0x10 // TX2IF in PIR3, TX2IE in PIE3
+#define TXSIZE 128 // transmit ring size, a power of 2
+#define TXMASK (TXSIZE - 1)
 #define TOKENSIZE 35
+#define RX_SYNC 0 // hunting for FRMSYNC
+#define RX_NODE 1 // frame decoder states, one per header field
+#define RX_TYPE 2
+#define RX_LEN 3
+#define RX_DATA 4
+#define RX_CRCH 5
+#define RX_CRCL 6
+#define T2FLAG PIR1bits.TMR2IF
+#define INT0FLAG INTCONbits.INT0IF
+#define T2TENMILSEC 0x4D // Timer2 on, 1:4 prescale, 1:10 postscale
+#define PR2TENMILSEC 249 // 10ms tick with T2TENMILSEC at 4MHz
+#define DUTYTICKS 1000 // ticks per duty cycle report (10s)
+#define TICKCYCLES 10000 // instruction cycles per tick at 4MHz
+#define ZONECOUNT 2 // display cases driven by this controller
+#define ZONE_PWM 0 // tray ramped by CCP1/CCP2, cut by limit IOC and current sense
+#define ZONE_RELAY 1 // tray switched on and off, limits read on the tick
+#define ZONEBUDGET 2000 // cycles all zones may take per tick, 20% of TICKCYCLES
+#define ZSTSIZE 48 // longest $ZST reply
  
 // Global Variables  ----------------------------------------------------------
 char serviceMode = FALSE;
-char buf1[] = {"$ALM\r"};
+volatile unsigned int fireMask = FALSE; //channels of the fire detection system that are in alarm, read by interlockISR
+char lockCmd = FALSE; //TRUE while a $LCK,1 command holds every door locked
+unsigned int cmdErrors = 0; //sentences rejected for checksum, format or command
+volatile char motorDir = FALSE; //TRAY_DOWN, TRAY_UP or FALSE once at rest
+volatile unsigned char pwmTarget = 0; //duty the ramp is heading for
+volatile unsigned char pwmDuty = 0; //duty being driven
+volatile unsigned int limitStops = 0; //travels cut by a limit switch interrupt
+volatile unsigned int motorCurrent = 0; //last motor current sample
+volatile char overCount = 0; //consecutive samples over stallLimit
+volatile unsigned long runSum = 0; //full duty current samples of the travel under way
+volatile unsigned int runCount = 0; //samples in runSum
+unsigned int runCurrent[2]; //learned lowering [0] and raising [1] running current, 0 until learned
+volatile unsigned int stallLimit[2]; //current adcISR trips at in each direction, 0 until learned
+volatile char stallCause = FALSE; //FLT_CURRENT once adcISR has cut a stalled motor
+volatile unsigned int lowerTick = 0; //tick lockdown last started a lowering
+volatile char lowerFromTop = FALSE; //TRUE if that lowering left the top limit switch
+unsigned char evacSeq = 0; //sequence number of the last frame sent by this node
+volatile char lockActive = FALSE; //TRUE while the inputs demand a lockdown
+volatile char snapIndex = 0; //inputs of the last port snapshot, packed
+volatile char decision = DEC_SECURE; //decisionTable entry of snapIndex
+unsigned int decisionErrors = 0; //combinations where the table and the old rules differ
+ 
+// Interlock decision of every input combination, built by the compiler
+const rom char decisionTable[DECISIONS] = 
+{
+DECIDE16(0), DECIDE16(16), DECIDE16(32), DECIDE16(48)
+};
+volatile unsigned int lastSnap = 0; //isrEntry of the previous port snapshot
+volatile unsigned int lockHist[LATBINS]; //lockdown latencies, power of 2 bins from 2^LATSHIFT us
+volatile unsigned int lockLatMax[2]; //worst LAT_EDGE and LAT_POLL lockdown latency (us)
+ 
+// Zones ---------------------------------------------------------------------
+// One row per display case. Limit switches and the case sensor pull low when 
+// closed; the door lock output locks when low. A new case is a new row.
+typedef struct
+{
+char drive; //ZONE_PWM or ZONE_RELAY
+volatile near unsigned char *inPort; //port of the limit switches and case sensor
+unsigned char upMask; //top limit
+unsigned char downMask; //bottom limit
+unsigned char caseMask; //case sensor, demands securing when opened, 0 if none
+volatile near unsigned char *motorLat; //latch of a ZONE_RELAY motor, NULL for ZONE_PWM
+unsigned char lowerMask; //output lowering the tray
+unsigned char raiseMask; //output raising the tray
+volatile near unsigned char *lockLat; //latch of the door lock
+unsigned char lockMask;
+} zoneDesc_t;
+ 
+const rom zoneDesc_t zoneTable[ZONECOUNT] = 
+{
+{ZONE_PWM, &PORTB, 0x10, 0x20, 0x00, NULL, 0x00, 0x00, &LATD, 0x01}, // RB4/RB5 limits, CCP motor, RD0 lock
+{ZONE_RELAY, &PORTA, 0x02, 0x04, 0x08, &LATD, 0x04, 0x08, &LATE, 0x01} // RA1/RA2 limits, RA3 case, RD2/RD3 motor, RE0 lock
+};
+ 
+typedef struct
+{
+char state; //TRAY_STOPPED, TRAY_LOWERING, TRAY_RAISING or TRAY_FAULT
+unsigned int tick; //tick the zone entered state
+unsigned int nominal[2]; //learned lowering [0] and raising [1] ticks, 0 until learned
+unsigned int faults; //travels that stalled or timed out
+unsigned int secureTime; //time the last lowering took to secure the artifact (ms)
+unsigned int secureTimeMax; //longest time to secure seen (ms)
+char secureCmd; //TRUE while a $ZSR,z,1 command holds the zone secured
+char lockCmd; //TRUE while a $ZLK,z,1 command holds the door locked
+char latched; //TRUE from a securing demand until the tray is down, like the old downFlag
+char locked; //lock state runZones last wrote to the door
+char fromLimit; //TRUE if the travel under way started at the opposite limit switch
+} zone_t;
+ 
+zone_t zones[ZONECOUNT];
+unsigned int zoneTick = 0; //tick the zones last ran
+unsigned int zoneCyclesMax[ZONECOUNT]; //worst cycles one pass of each zone took
+unsigned int schedCycles = 0; //cycles the last pass of all zones took
+unsigned int schedCyclesMax = 0; //worst pass of all zones
+unsigned int schedOverruns = 0; //passes over ZONEBUDGET
  
 typedef char flag_t;
 flag_t sentenceRdy = FALSE;
-char receivingbuf[BUFSIZE];
-char *tokens[TOKENSIZE];
+char receivingbuf[BUFSIZE]; //last complete sentence, read by the foreground
+char assembly[BUFSIZE]; //sentence being assembled from the receive ring
+char *tokens[TOKENSIZE]; //fields of the last sentence, pointing into receivingbuf
 char insert = 0;
 char hold = 0;
+volatile unsigned char rxRing[RXSIZE]; //received bytes, filled by the ISR only
+volatile char rxHead = 0; //next free slot, written by the ISR only
+volatile char rxTail = 0; //next byte to read, written by the foreground only
+volatile unsigned int rxOverflows = 0; //bytes lost to a full ring or a USART overrun
+unsigned int rxDropped = 0; //bytes discarded by the sentence assembler
+unsigned char txBuf[TXSIZE]; //transmit ring, filled by queueTX and emptied by txISR
+volatile unsigned char txHead = 0; //next free slot, written by the foreground only
+volatile unsigned char txTail = 0; //next byte to send, written by txISR only
+unsigned int txDrops = 0; //sentences and frames dropped because the ring was full
+unsigned char txDepthMax = 0; //most bytes waiting in the ring
+ 
+typedef struct
+{
+unsigned char node; //sending node
+unsigned char type; //FRM_ALM, FRM_CLR or FRM_SEN
+unsigned char len; //bytes in payload
+unsigned char payload[FRMMAX];
+} frame_t;
+ 
+frame_t rxWork; //frame being decoded
+frame_t rxFrame; //last good frame, read by the foreground
+flag_t frameRdy = FALSE; //TRUE while rxFrame holds an unread frame
+char rxState = RX_SYNC; //frame decoder state
+char rxCount = 0; //payload bytes decoded so far
+unsigned int rxCrc = CRCINIT; //running CRC of the frame being decoded
+unsigned int rxCrcRecv = 0; //CRC sent with the frame
+unsigned int crcErrors = 0; //frames rejected for a bad CRC or length
+unsigned int frameDrops = 0; //good frames lost while rxFrame was unread
+unsigned char fireSeq = 0; //sequence number of the last fire frame
+unsigned int fireLost = 0; //fire frames missed according to their sequence
+ 
 // Prototypes
 
-void ISR();
+void interlockISR(void);
+void intruderISR(void);
+void tickISR(void);
+void limitISR(void);
+void rxISR(void);
+void txISR(void);
+void adcISR(void);
+void rampPWM(void);
+void cutMotor(void);
+void lockdown(char cause, unsigned int since);
+void cmdAlarm(char argc, char **argv);
+void cmdClear(char argc, char **argv);
+void cmdService(char argc, char **argv);
+void cmdLock(char argc, char **argv);
+void cmdStatus(char argc, char **argv);
+void cmdHistogram(char argc, char **argv);
+void cmdZoneSecure(char argc, char **argv);
+void cmdZoneLock(char argc, char **argv);
+void cmdZoneStatus(char argc, char **argv);
  
-// Interrupt Vector 
+typedef void (*cmdHandler_t)(char argc, char **argv);
  
-#pragma code interrupt_vector = 0x08
+typedef struct
+{
+const rom char *name; //command word, NULL for an empty bucket
+cmdHandler_t handler; //called with the argument fields
+} command_t;
  
-void interrupt_vector(void)
+// Commands sit in the bucket given by cmdHash of their name, so a sentence
+// costs one hash and one compare however many commands there are. 
+// A new command must land in an empty bucket.
+const rom command_t cmdTable[CMDBUCKETS] = 
 {
-_asm
-GOTO ISR
-_endasm
-}
+{NULL, NULL}, 				// 0
+{"ALM", cmdAlarm}, 		// 1 $ALM,ch raises fire channel ch
+{"HST", cmdHistogram}, 	// 2 $HST replies with the lockdown latency histogram
+{NULL, NULL}, 				// 3
+{NULL, NULL}, 				// 4
+{NULL, NULL}, 				// 5
+{"CLR", cmdClear}, 		// 6 $CLR,ch clears fire channel ch
+{"STS", cmdStatus}, 		// 7 $STS replies with the controller status
+{NULL, NULL}, 				// 8
+{NULL, NULL}, 				// 9
+{"ZST", cmdZoneStatus}, 	// 10 $ZST,z replies with the status of zone z
+{"ZLK", cmdZoneLock}, 		// 11 $ZLK,z,1 holds the door of zone z locked, $ZLK,z,0 releases it
+{"ZSR", cmdZoneSecure}, 	// 12 $ZSR,z,1 secures zone z, $ZSR,z,0 releases it
+{"LCK", cmdLock}, 			// 13 $LCK,1 holds the door locked, $LCK,0 releases it
+{"SRV", cmdService}, 		// 14 $SRV,1 enters service mode, $SRV,0 leaves it
+{NULL, NULL} 				// 15
+};
  
-#pragma code 
+// Interrupt sources ---------------------------------------------------------
+// Dispatched by nodeIsr.c. The interlock snapshot runs on every high entry,
+// ahead of the sources, whatever woke the controller.
+const rom isrSource_t highTable[] = 
+{
+{NULL, 0, NULL, 0, interlockISR},
+{&INTCON, INT0MASKF, &INTCON, INT0MASKE, intruderISR},
+{&INTCON, RBMASKF, &INTCON, RBMASKE, limitISR},
+{&PIR1, TMR2MASK, &PIE1, TMR2MASK, tickISR},
+{NULL, 0, NULL, 0, NULL}
+};
+ 
+// serial link and current samples on the low vector, receiver first
+const rom isrSource_t lowTable[] = 
+{
+{&PIR3, RC2MASK, &PIE3, RC2MASK, rxISR},
+{&PIR3, TX2MASK, &PIE3, TX2MASK, txISR},
+{&PIR1, ADCMASK, &PIE1, ADCMASK, adcISR},
+{NULL, 0, NULL, 0, NULL}
+};
  
 // Functions  -----------------------------------------------------------------
  
@@ -129,7 +406,7 @@ Returns:	None
 ----------------------------------------------------------------------------*/
 void configPort(void)
 {
-ANSELA 	= 0x00; //Sets the PORTA for digital operation
+ANSELA 	= 0x01; //Sets RA0 of PORTA for the analog motor current
 LATA	    	= 0x00; //Sets the PORTA for no output
 TRISA		= 0xFF; //Sets the PORTA for input operation
 ANSELB	= 0x00; //Sets the first 2 bits of PORTB for analog operation
@@ -137,49 +414,129 @@ LATB		= 0x00; //Sets the PORTB for no output
 TRISB		= 0xF3; //Sets the 3rd and 4th bits of PORTB for output operation
 ANSELC 	= 0X00; //Sets all the pins of PORTC for digital operation
 LATC 		= 0X00; //Sets all the pins of PORTC for no outpout
-TRISC	= 0XFF; //Sets all the pins of PORTC as inputs
+TRISC	= 0XF0; //Sets RC0 to RC3 of PORTC as motor outputs
 ANSELD 	= 0X00; //Sets all the pins of PORTD for digital operation
 LATD 		= 0X00; //Sets all the pins of PORTD for no outpout
-TRISD	= 0XFE; //Sets all the pins of PORTD as inputs
+TRISD	= 0XF2; //Sets RD0, RD2 and RD3 of PORTD as the door lock and zone 1 motor outputs
+ANSELE 	= 0X00; //Sets all the pins of PORTE for digital operation
+LATE 		= 0X00; //Sets all the pins of PORTE for no outpout
+TRISE	= 0XFE; //Sets RE0 of PORTE as the zone 1 door lock output
 } // eo configPort::
  
 /*>>>configUSART2::===============================================
 Author:	Vaibhav Sinha
 Date:		11/06/2024
 Modified:	None
-Desc:		This function sets the USART2 for  19.2k baud rate, SP1 on, TX & RX 
-enabled, 8 bit, 1 stop bit, non-inverted.
+Desc:		This function sets the USART2 for 38.4k baud rate (16 bit BRG, 
+0.16% error at 4MHz) to match the fire detection system, SP2 on, 
+TX & RX enabled, 8 bit, 1 stop bit, non-inverted.
 Input: 		None
 Returns:	None
 =================================================================*/
 void configUSART2(void)
 {
-BAUDCON1 		= 0X40;
-TXSTA1		= 0X26;
-RCSTA1 		= 0X90;
-SPBRG1 		= 12;
-SPBRGH		= 0;
+BAUDCON2 		= 0X48;
+TXSTA2		= 0X26;
+RCSTA2 		= 0X90;
+SPBRG2 		= 25;
+SPBRGH2		= 0;
  
 }// eo configUSART2::
  
+/*>>> configTMR2: -----------------------------------------------------------
+Author:	
+Date:		
+Modified:	None
+Desc:		Sets Timer2 for the 10ms tick that wakes the controller to poll its
+inputs.
+Input: 		None
+Returns:	None
+----------------------------------------------------------------------------*/
+void configTMR2(void)
+{
+TMR2 = FALSE;
+PR2 = PR2TENMILSEC;
+T2CON = T2TENMILSEC;
+} // eo configTMR2::
+ 
+/*>>> configPWM: -----------------------------------------------------------
+Author:	
+Date:		
+Modified:	None
+Desc:		Sets CCP1 (RC2, lowering) and CCP2 (RC1, raising) for 20kHz PWM on a
+Timer4 timebase, leaving Timer2 for the tick. Both start at 0% duty.
+Input: 		None
+Returns:	None
+----------------------------------------------------------------------------*/
+void configPWM(void)
+{
+CCPTMRS0 = CCPTMR4;
+PR4 = PWMPR;
+T4CON = T4PWM;
+CCPR1L = FALSE;
+CCPR2L = FALSE;
+CCP1CON = CCPPWM;
+CCP2CON = CCPPWM;
+} // eo configPWM::
+ 
+/*>>> configADC: -----------------------------------------------------------
+Author:	
+Date:		
+Modified:	None
+Desc:		Sets the ADC on AN0, the motor current sense, and CCP5 in special 
+event trigger mode on Timer3 so that the hardware starts a conversion
+every SAMPLEPERIOD cycles (1kHz) with no software involved.
+Input: 		None
+Returns:	None
+----------------------------------------------------------------------------*/
+void configADC(void)
+{
+ADCON0 = ADCAN0;
+ADCON1 = FALSE;
+ADCON2 = ADCTIMING;
+CCPTMRS1 = CCPTMR3;
+CCPR5H = SAMPLEPERIOD >> BYTESIZE;
+CCPR5L = SAMPLEPERIOD & 0xFF;
+CCP5CON = CCPTRIGGER;
+T3CON = T3SAMPLE;
+} // eo configADC::
+ 
 /*>>> configINTS: -----------------------------------------------------------
 Author:	Vaibhav Sinha
 Date:		11/06/2024
 Modified:	None
-Desc:		Initializes interrupts for Timer0 and Receiver #2 to enable their 
-operation.
+Desc:		Initializes interrupts for Timer2, INT0, the limit switch 
+interrupt-on-change, Receiver #2, Transmitter #2 and the ADC to enable
+their operation. The safety inputs and the tick are high priority, 
+the serial link and the current samples low.
 Input: 		None
 Returns:	None
 ----------------------------------------------------------------------------*/
 void configINTS(void)
 {
+// Timer2 tick and any edge of the intruder input wake the controller
+T2FLAG = FALSE;
+IPR1bits.TMR2IP = TRUE;
+PIE1bits.TMR2IE = TRUE;
+INTCON2bits.INTEDG0 = !INTRUDER; // next edge of RB0, INT0 is always high priority
+INT0FLAG = FALSE;
+INTCONbits.INT0IE = TRUE;
+IOCB = LIMITIOC;
+hold = PORTB; // ending any mismatch before enabling
+IOCFLAG = FALSE;
+INTCON2bits.RBIP = TRUE;
+INTCONbits.RBIE = TRUE;
+
 // Configure Receiver #1 interrupt
 IPR3bits.RC2IP 	= FALSE;    // Receiver #1 interrupt priority set to low
 PIR3bits.RC2IF 	= FALSE;    // Clear Receiver #1 interrupt flag
 PIE3bits.RC2IE 	= TRUE;     // Enable Receiver #1 interrupt
+IPR3bits.TX2IP 	= FALSE;    // Transmitter #2 low priority, enabled by queueTX
+ADCFLAG = FALSE;
+IPR1bits.ADIP = FALSE; // motor current samples, enabled while the motor runs
 
-RCONbits.IPEN 	= FALSE;     // Global interrupt priority disabled
-INTCON 		|= INTGON; // Enable interrupts globally
+RCONbits.IPEN 	= TRUE;     // Global interrupt priority enabled
+INTCON 		|= INTGON; // Enable high and low priority interrupts
 } // eo configINTS ::
  
 /*>>> systemInitialization: ------------------------------------------------- 
@@ -197,122 +554,1549 @@ void systemInitialization(void)
 configOSC4MHz();
 configPort();
 configUSART2();
+configTMR2();
+configPWM();
+configADC();
 configINTS();
+configPwrMgmt(TICKCYCLES, DUTYTICKS); // Timer1 cycle counts, SLEEP enters IDLE
 
 } // eo systemInitialization::
  
-#pragma interrupt ISR //pragma for interrupt service routine
+/*>>> rampPWM: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		Called by tickISR on every tick, this function moves the duty of the
+running motor RAMPUP or RAMPDOWN towards pwmTarget and writes it to 
+the CCP of the direction of travel. Once a stop has ramped to rest the
+high side enables are released and motorDir cleared.
+Input: 		None
+Returns:	None
+============================================================================*/
+void rampPWM(void)
+{
+if(pwmDuty < pwmTarget)
+{
+pwmDuty = (pwmTarget - pwmDuty > RAMPUP) ? pwmDuty + RAMPUP : pwmTarget;
+}
+else if(pwmDuty > pwmTarget)
+{
+pwmDuty = (pwmDuty - pwmTarget > RAMPDOWN) ? pwmDuty - RAMPDOWN : pwmTarget;
+}
+else if(!pwmDuty)
+{
+M1FWD = FALSE;
+M1REV = FALSE;
+motorDir = FALSE;
+PIE1bits.ADIE = FALSE; // no current to watch
+return;
+}
+if(motorDir == TRAY_DOWN)
+{
+CCPR1L = pwmDuty >> PWMSHIFT;
+CCP1CONbits.DC1B = pwmDuty & PWMLOW;
+}
+else if(motorDir == TRAY_UP)
+{
+CCPR2L = pwmDuty >> PWMSHIFT;
+CCP2CONbits.DC2B = pwmDuty & PWMLOW;
+}
+} // eo rampPWM ::
  
-/*>>> ISR: ===========================================================
-Author:	Vaibhav Sinha
-Date:		11/06/2024
+/*>>> lockdown: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		Called by interlockISR when the inputs start demanding a lockdown, this 
+function locks the door and starts lowering the tray without waiting
+for the foreground: from rest it starts the lowering ramp, while 
+raising it ramps the motor down for trayStep to reverse. The time 
+from the input changing to DLOCK is added to lockHist and to the 
+lockLatMax of its cause. A lowering started here notes its tick and
+whether it left the top limit, for trayStep to take over. An INT0 edge is timed from the Timer1 count 
+the vector stored, less EDGECYCLES of interrupt response. A sampled 
+input may have changed just after the previous snapshot, so it is 
+timed from there, which charges it the sampling delay. The doors of
+the other zones are locked here too; their trays start on the next 
+pass of runZones.
+Input: 		char cause, LAT_EDGE or LAT_POLL.
+unsigned int since, Timer1 count the input is taken to have changed.
+Returns:	None
+============================================================================*/
+void lockdown(char cause, unsigned int since)
+{
+unsigned int latency = 0;
+unsigned int scaled = 0;
+char bin = 0;
+char zone = 0;
+DLOCK = FALSE; //locking the door
+latency = TMR1L;
+latency |= (unsigned int)TMR1H << BYTESIZE;
+latency -= since; //1us per count at 4MHz
+if(motorDir == TRAY_UP)
+{
+LEDREV = FALSE;
+pwmTarget = 0;
+}
+else if(!motorDir && !ATBOTTOM)
+{
+LEDFWD = TRUE;
+lowerTick = tickCount;
+lowerFromTop = ATTOP;
+runSum = 0;
+runCount = 0;
+pwmTarget = PWMMAX;
+motorDir = TRAY_DOWN;
+M1FWD = TRUE;
+PIE1bits.ADIE = TRUE;
+}
+for(scaled = latency >> LATSHIFT; scaled && bin < LATBINS - 1; scaled >>= 1)
+{
+bin++;
+}
+lockHist[bin]++;
+if(latency > lockLatMax[cause])
+{
+lockLatMax[cause] = latency;
+}
+for(zone = 1; zone < ZONECOUNT; zone++)
+{
+*zoneTable[zone].lockLat &= ~zoneTable[zone].lockMask;
+}
+} // eo lockdown ::
+ 
+/*>>> intruderISR: ===========================================================
+Author:	
+Date:		
 Modified:	None
-Desc:		This function will interupt the main function on the event of 
-recieving data from the evacuation system and will store it into
-an array for further processing.		
+Desc:		This function acknowledges an intruder edge on INT0 and arms INT0 for
+the opposite edge; the lockdown itself is checked by interlockISR.
 Input: 		None
 Returns:	None
 ============================================================================*/
+void intruderISR(void)
+{
+INT0FLAG = FALSE;
+INTCON2bits.INTEDG0 ^= TRUE; // waking on the opposite edge next
+} // eo intruderISR ::
  
-void ISR(void)
+/*>>> tickISR: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		This function counts the 10ms ticks and steps the PWM ramp.
+Input: 		None
+Returns:	None
+============================================================================*/
+void tickISR(void)
 {
-char i=0;
-if(RC2FLAG == TRUE)
+T2FLAG = FALSE;
+tickCount++;
+rampPWM();
+} // eo tickISR ::
+ 
+/*>>> cutMotor: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		This function stops the motor at once, with no ramp, by zeroing both 
+PWM duties and releasing the high side enables. It must run with the 
+high priority interrupts held off unless called from them.
+Input: 		None
+Returns:	None
+============================================================================*/
+void cutMotor(void)
 {
-hold = RCREG2;
-if(hold == '$')
+pwmTarget = 0;
+pwmDuty = 0;
+CCPR1L = FALSE;
+CCPR2L = FALSE;
+M1FWD = FALSE;
+M1REV = FALSE;
+motorDir = FALSE;
+PIE1bits.ADIE = FALSE;
+} // eo cutMotor ::
+ 
+/*>>> limitISR: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		A limit switch closing in the direction of travel cuts the motor off
+at once, with no ramp.
+Input: 		None
+Returns:	None
+============================================================================*/
+void limitISR(void)
 {
-for(i=0;i<30; i++)
+hold = PORTB; // ending the mismatch
+IOCFLAG = FALSE;
+if((motorDir == TRAY_DOWN && ATBOTTOM) || (motorDir == TRAY_UP && ATTOP))
 {
-receivingbuf[i]=0;
+cutMotor();
+limitStops++;
 }
-insert = 0;	
+} // eo limitISR ::
+ 
+/*>>> adcISR: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		This function takes each motor current sample started by CCP5. Once 
+the motor is at full duty, past its start ramp, each sample is added
+to runSum for learnCurrent, and STALLSAMPLES samples in a row over 
+the stallLimit of the direction mean a stall: the motor is cut within
+50ms and stallCause tells trayStep to report it. Until a full travel
+has taught the running current, stallLimit is 0 and only the travel 
+time guards the motor.
+Input: 		None
+Returns:	None
+============================================================================*/
+void adcISR(void)
+{
+ADCFLAG = FALSE;
+motorCurrent = ADRES;
+if(!motorDir || pwmDuty < PWMMAX)
+{
+overCount = 0;
+return;
 }
-if(hold == '\r')
+runSum += motorCurrent;
+runCount++;
+if(!stallLimit[motorDir - 1] || motorCurrent <= stallLimit[motorDir - 1])
 {
-sentenceRdy = TRUE;
+overCount = 0;
+return;
 }
-receivingbuf[insert] = hold;
-insert++;
+overCount++;
+if(overCount >= STALLSAMPLES)
+{
+overCount = 0;
+INTCONbits.GIEH = FALSE; // the tick ramps the same outputs
+cutMotor();
+INTCONbits.GIEH = TRUE;
+stallCause = FLT_CURRENT;
 }
-INTCON |= 0xC0;
-} // eo ISR ::
+} // eo adcISR ::
  
-/*>>> receivedSen: ===========================================================
-Author:	Vaibhav Sinha
-Date:		11/06/2024
+/*>>> rxISR: ===========================================================
+Author:	
+Date:		
 Modified:	None
-Desc:		This function will use the serial communication to receive a string.
+Desc:		This function stores the byte received from the fire detection system
+in the receive ring in constant time; the foreground owns everything
+past the ring. A full ring or a USART overrun loses bytes, which are 
+counted in rxOverflows.
 Input: 		None
 Returns:	None
 ============================================================================*/
-void receivedSen(void)
+void rxISR(void)
+{
+char byte = 0;
+char next = 0;
+if(RCSTA2bits.OERR) // receiver stalled, restarting it
+{
+RCSTA2bits.CREN = FALSE;
+RCSTA2bits.CREN = TRUE;
+rxOverflows++;
+}
+byte = RCREG2;
+next = (rxHead + 1) & RXMASK;
+if(next == rxTail)
 {
-puts2USART(receivingbuf);
+rxOverflows++;
 }
+else
+{
+rxRing[rxHead] = byte;
+rxHead = next;
+}
+} // eo rxISR ::
  
+/*>>> txISR: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		This function feeds USART2 from the transmit ring and disables the 
+transmitter interrupt once the ring is drained.
+Input: 		None
+Returns:	None
+============================================================================*/
+void txISR(void)
+{
+if(txTail != txHead)
+{
+TXREG2 = txBuf[txTail];
+txTail = (txTail + 1) & TXMASK;
+}
+else
+{
+PIE3bits.TX2IE = FALSE; // ring drained
+}
+} // eo txISR ::
  
-/*--- MAIN: FUNCTION ----------------------------------------------------------
-----------------------------------------------------------------------------*/
-void main( void )
+/*>>> interlockISR: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		The first row of highTable, run on every entry of the high vector 
+whatever woke it. It packs one snapshot of the input ports into 
+snapIndex and looks the interlock decision up in decisionTable, so 
+that an intruder edge on INT0, or a breach or alarm seen on the tick,
+locks the door straight away.
+Input: 		None
+Returns:	None
+============================================================================*/
+void interlockISR(void)
 {
-char downFlag = FALSE; //flag for downward movement of the tray
-char upFlag = FALSE; //flag for upward movement of the tray
-int fireAlarm = TRUE; //variable that stores the results of fire detection data validation
-systemInitialization(); //configures the system as per operation requirements 
+char index = 0;
+// one snapshot of the input ports, so every rule sees the same instant
+index = PACKINDEX(PORTB, PORTC, PORTD, fireMask, serviceMode);
+decision = decisionTable[index];
+// intruder edges are caught by INT0, the other inputs on every tick
+if((decision & DEC_SECURE) != lockActive)
+{
+lockActive = !lockActive;
+if(lockActive && INT0FLAG && ((index ^ snapIndex) & IDX_INTRUDER))
+{
+lockdown(LAT_EDGE, isrEntry - EDGECYCLES);
+}
+else if(lockActive)
+{
+lockdown(LAT_POLL, lastSnap);
+}
+}
+snapIndex = index;
+lastSnap = isrEntry;
+} // eo interlockISR ::
  
-while(1)
+/*>>> decodeFrame: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		Called by pollRX with every byte of a binary frame: sync, node id, 
+type, payload length, payload and the CRC-16 of the node id to payload
+bytes, high byte first. The CRC is updated byte by byte with 
+crc16Update, as the sender computes it. A good frame is copied to 
+rxFrame; a bad one is counted in crcErrors and the decoder goes back
+to hunting for FRMSYNC.
+Input: 		unsigned char byte, the received byte.
+Returns:	None
+============================================================================*/
+void decodeFrame(unsigned char byte)
+{
+if(rxState != RX_SYNC && rxState < RX_CRCH)
+{
+rxCrc = crc16Update(rxCrc, byte);
+}
+switch(rxState)
+{
+case RX_SYNC:
+rxCrc = CRCINIT;
+rxState = RX_NODE;
+break;
+ 
+case RX_NODE:
+rxWork.node = byte;
+rxState = RX_TYPE;
+break;
+ 
+case RX_TYPE:
+rxWork.type = byte;
+rxState = RX_LEN;
+break;
+ 
+case RX_LEN:
+rxWork.len = byte;
+rxCount = 0;
+if(byte > FRMMAX)
+{
+crcErrors++;
+rxState = RX_SYNC;
+}
+else
+{
+rxState = byte ? RX_DATA : RX_CRCH;
+}
+break;
+ 
+case RX_DATA:
+rxWork.payload[rxCount++] = byte;
+if(rxCount >= rxWork.len)
+{
+rxState = RX_CRCH;
+}
+break;
+ 
+case RX_CRCH:
+rxCrcRecv = (unsigned int)byte << BYTESIZE;
+rxState = RX_CRCL;
+break;
+ 
+default:
+rxState = RX_SYNC;
+if((rxCrcRecv | byte) != rxCrc)
+{
+crcErrors++;
+}
+else if(frameRdy)
+{
+frameDrops++;
+}
+else
+{
+rxFrame = rxWork;
+frameRdy = TRUE;
+}
+break;
+}
+} // eo decodeFrame ::
+ 
+/*>>> assembleSen: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		This function builds '$' to '\r' sentences out of received bytes in
+assembly and copies each complete one to receivingbuf. Bytes outside a
+sentence, sentences longer than BUFSIZE and sentences that arrive while
+the last one is still unread are counted in rxDropped.
+Input: 		char byte, the received byte.
+Returns:	None
+============================================================================*/
+void assembleSen(char byte)
+{
+if(byte == '$')
+{
+rxDropped += insert; // an unfinished sentence is abandoned
+insert = 0;
+}
+else if(!insert)
+{
+rxDropped++; // not inside a sentence
+return;
+}
+if(insert >= BUFSIZE - 1)
+{
+rxDropped += insert + 1; // too long, waiting for the next '$'
+insert = 0;
+return;
+}
+assembly[insert++] = byte;
+if(byte == '\r')
 {
-fireAlarm = strcmp(receivingbuf, buf1); //compairing the recieved string from fire detection system 
 if(sentenceRdy)
 {
-sentenceRdy = FALSE;
-receivedSen(); //calling the function
+rxDropped += insert;
+}
+else
+{
+assembly[insert] = 0;
+strcpy(receivingbuf, assembly);
+sentenceRdy = TRUE;
+}
+insert = 0;
 }
+} // eo assembleSen ::
  
-if(INTRUDER||serviceMode)
+/*>>> pollRX: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		This function empties the receive ring, handing binary frames to the
+frame decoder and everything else to the sentence assembler. It stops
+at a complete frame or sentence so that the next one waits in the ring
+until main has read it. Only the foreground moves rxTail, so no 
+interrupt masking is needed.
+Input: 		None
+Returns:	None
+============================================================================*/
+void pollRX(void)
 {
-DLOCK = TRUE;
+char tail = rxTail;
+unsigned char byte = 0;
+while(tail != rxHead && !frameRdy && !sentenceRdy)
+{
+byte = rxRing[tail];
+tail = (tail + 1) & RXMASK;
+rxTail = tail;
+if(rxState != RX_SYNC || byte == FRMSYNC)
+{
+decodeFrame(byte);
 }
-
-while((!INTRUDER && !REMOX) || !fireAlarm || TALARM || PASSBREACH || downFlag)
+else
+{
+assembleSen(byte);
+}
+}
+} // eo pollRX ::
+ 
+/*>>> checkFireFrame: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		The fire detection node sends FRM_ALM when a channel raises the 
+alarm and FRM_CLR when it clears, each with the sequence number and 
+channel in its first two payload bytes, so this function keeps one bit
+per channel of the fire node. Gaps in the sequence are counted in
+fireLost; sensor frames only advance the sequence. Channels past 
+FIRECHMAX have no bit and are ignored.
+Input: 		unsigned int mask, the channels currently in alarm.
+Returns:	unsigned int, the channels in alarm after the received frame.
+============================================================================*/
+unsigned int checkFireFrame(unsigned int mask)
 {
-downFlag = TRUE;
-DLOCK = FALSE; //locking the door(Normally in unlocked state) 
-if (!LMTUP && LMTDWN)//artifact is exposed
+unsigned int chBit = 0;
+if(rxFrame.node != FIRENODE || rxFrame.len < 2)
 {
-LEDFWD = TRUE;
-M1FWD = TRUE;
-M2REV = TRUE;
+return mask;
 }
-if (!LMTDWN && LMTUP)//artifact is secured
+fireLost += (unsigned char)(rxFrame.payload[0] - fireSeq - 1);
+fireSeq = rxFrame.payload[0];
+if(rxFrame.type == FRM_SEN || rxFrame.payload[1] >= FIRECHMAX)
 {
-LEDFWD = FALSE;
-M1FWD = FALSE;
-M2REV = FALSE;
-downFlag = FALSE;			
+return mask;
 }
-} // eo while intruder
-
-` 		while(REMOX||upFlag)
+chBit = 1u << rxFrame.payload[1];
+if(rxFrame.type == FRM_ALM)
 {
-DLOCK = TRUE; //unlocking the door
-upFlag=TRUE;
-if (!LMTDWN) //artifact is secured
+mask |= chBit;
+}
+else if(rxFrame.type == FRM_CLR)
 {
-LEDREV = TRUE;
-M1REV = TRUE;
-M2FWD = TRUE;
+mask &= ~chBit;
 }
-if (!LMTUP)//artifact is exposed
+return mask;
+} // eo checkFireFrame ::
+ 
+/*>>> setFireMask: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		This function stores the fire channels in alarm with the high 
+priority interrupts held off, so interlockISR never packs a 
+half-written fireMask into its decision index.
+Input: 		unsigned int mask, the channels in alarm.
+Returns:	None
+============================================================================*/
+void setFireMask(unsigned int mask)
 {
-LEDREV = FALSE;
-M1REV = FALSE;
-M2FWD = FALSE;
-upFlag = FALSE;
+INTCONbits.GIEH = FALSE;
+fireMask = mask;
+INTCONbits.GIEH = TRUE;
+} // eo setFireMask ::
+ 
+/*>>> queueTX: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		This function stores a sentence or frame whole in the transmit ring 
+and enables the transmitter interrupt that forwards it. One that does
+not fit is dropped whole and counted in txDrops, so the caller never 
+waits. The deepest the ring has been is kept in txDepthMax.
+Input: 		unsigned char *data, the bytes to be sent.
+char len, the number of bytes.
+Returns:	char, TRUE if the bytes were queued.
+============================================================================*/
+char queueTX(unsigned char *data, char len)
+{
+unsigned char head = txHead;
+if(((txTail - head - 1) & TXMASK) < (unsigned char)len) // free slots in the ring
+{
+txDrops++;
+return FALSE;
+}
+for(; len > 0; len--)
+{
+txBuf[head] = *data++;
+head = (head + 1) & TXMASK;
+}
+txHead = head;
+PIE3bits.TX2IE = TRUE;
+if(((head - txTail) & TXMASK) > txDepthMax)
+{
+txDepthMax = (head - txTail) & TXMASK;
+}
+return TRUE;
+} // eo queueTX ::
+ 
+/*>>> queueSen: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		This function queues a string for transmission.
+Input: 		char *sentence, the string to be sent.
+Returns:	char, TRUE if the string was queued.
+============================================================================*/
+char queueSen(char *sentence)
+{
+return queueTX((unsigned char *)sentence, strlen(sentence));
+} // eo queueSen ::
+ 
+/*>>> reportDuty: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		Every DUTYTICKS ticks this function reports the new duty cycle figure
+of the power layer as $DTY,duty.
+Input: 		None
+Returns:	None
+============================================================================*/
+void reportDuty(void)
+{
+char sentence[BUFSIZE];
+if(!updateDuty())
+{
+return;
+}
+sprintf(sentence, "$DTY,%d\r", (int)dutyCycle);
+queueSen(sentence);
+} // eo reportDuty ::
+ 
+/*>>> receivedSen: ===========================================================
+Author:	Vaibhav Sinha
+Date:		11/06/2024
+Modified:	None
+Desc:		This function will use the serial communication to relay a received 
+string, stored whole in the transmit ring and forwarded by txISR.
+Input: 		None
+Returns:	None
+============================================================================*/
+void receivedSen(void)
+{
+queueSen(receivingbuf);
+}
+ 
+/*>>> queueFrame: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		This function builds a frame (sync, node id, type, payload length, 
+payload and the CRC-16 of the node id to payload bytes, high byte 
+first) and stores it whole in the transmit ring.
+Input: 		unsigned char node, the node the frame comes from.
+unsigned char type, the frame type.
+unsigned char *payload, the payload bytes.
+char count, the number of payload bytes, FRMMAX at most.
+Returns:	None
+============================================================================*/
+void queueFrame(unsigned char node, unsigned char type, unsigned char *payload, char count)
+{
+unsigned char frame[FRMHEAD + FRMMAX + FRMCRC];
+unsigned int crc = CRCINIT;
+char len = 0;
+frame[len++] = FRMSYNC;
+frame[len++] = node;
+frame[len++] = type;
+frame[len++] = count;
+for(; count > 0; count--)
+{
+frame[len++] = *payload++;
+}
+for(count = 1; count < len; count++)
+{
+crc = crc16Update(crc, frame[count]);
+}
+frame[len++] = crc >> BYTESIZE;
+frame[len++] = crc;
+queueTX(frame, len);
+} // eo queueFrame ::
+ 
+/*>>> relayFrame: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		This function forwards the frame in rxFrame, so fire frames reach the
+panel and logger as they were sent.
+Input: 		None
+Returns:	None
+============================================================================*/
+void relayFrame(void)
+{
+queueFrame(rxFrame.node, rxFrame.type, rxFrame.payload, rxFrame.len);
+} // eo relayFrame ::
+ 
+/*>>> cmdHash: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		This function hashes a command word into a bucket of cmdTable.
+Input: 		char *name, the command word.
+Returns:	char, the bucket of the command.
+============================================================================*/
+char cmdHash(char *name)
+{
+unsigned char hash = 0;
+while(*name)
+{
+hash = (hash << 1) ^ *name++;
 }
-}// eo while remote access
+return hash & CMDMASK;
+} // eo cmdHash ::
  
+/*>>> hexDigit: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		This function converts an upper case hexadecimal digit to its value.
+Input: 		char digit, the character to be converted.
+Returns:	char, the value of the digit, or -1 if it is not one.
+============================================================================*/
+char hexDigit(char digit)
+{
+if(digit >= '0' && digit <= '9')
+{
+return digit - '0';
+}
+if(digit >= 'A' && digit <= 'F')
+{
+return digit - 'A' + 10;
+}
+return -1;
+} // eo hexDigit ::
+ 
+/*>>> tokenizeSen: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		This function checks and splits a $CMD,arg,...*CS\r sentence in 
+place. CS is the XOR of the characters between '$' and '*' in two 
+upper case hex digits. Every ',' and the '*' are overwritten with a 
+terminator and tokens[] points at the fields, the command word first,
+so nothing is copied.
+Input: 		None
+Returns:	char, the number of fields, or 0 if the sentence is rejected.
+============================================================================*/
+char tokenizeSen(void)
+{
+char *pos = receivingbuf + 1;
+char count = 0;
+unsigned char sum = 0;
+if(receivingbuf[0] != '$')
+{
+return 0;
+}
+tokens[count++] = pos;
+while(*pos && *pos != '*')
+{
+sum ^= *pos;
+if(*pos == ',')
+{
+*pos = 0;
+if(count >= TOKENSIZE)
+{
+return 0;
+}
+tokens[count++] = pos + 1;
+}
+pos++;
+}
+if(*pos != '*' || hexDigit(pos[1]) < 0 || hexDigit(pos[2]) < 0 || pos[3] != '\r')
+{
+return 0;
+}
+*pos = 0;
+if((unsigned char)(hexDigit(pos[1]) * HEXBASE + hexDigit(pos[2])) != sum)
+{
+return 0;
+}
+return count;
+} // eo tokenizeSen ::
+ 
+/*>>> dispatchSen: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		This function tokenizes the sentence in receivingbuf and calls the 
+handler found in the command's bucket of cmdTable with the argument 
+fields. Rejected and unknown sentences are counted in cmdErrors.
+Input: 		None
+Returns:	None
+============================================================================*/
+void dispatchSen(void)
+{
+char count = tokenizeSen();
+const rom command_t *cmd = NULL;
+if(!count)
+{
+cmdErrors++;
+return;
+}
+cmd = &cmdTable[cmdHash(tokens[0])];
+if(cmd->name == NULL || strcmppgm2ram(tokens[0], cmd->name))
+{
+cmdErrors++;
+return;
+}
+cmd->handler(count - 1, tokens + 1);
+} // eo dispatchSen ::
+ 
+/*>>> cmdAlarm: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		$ALM,ch raises the alarm of fire channel ch, as a fire frame does.
+Input: 		char argc, the number of arguments.
+char **argv, the argument fields.
+Returns:	None
+============================================================================*/
+void cmdAlarm(char argc, char **argv)
+{
+if(argc >= 1 && (unsigned int)atoi(argv[0]) < FIRECHMAX)
+{
+setFireMask(fireMask | (1u << atoi(argv[0])));
+}
+} // eo cmdAlarm ::
+ 
+/*>>> cmdClear: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		$CLR,ch clears the alarm of fire channel ch.
+Input: 		char argc, the number of arguments.
+char **argv, the argument fields.
+Returns:	None
+============================================================================*/
+void cmdClear(char argc, char **argv)
+{
+if(argc >= 1 && (unsigned int)atoi(argv[0]) < FIRECHMAX)
+{
+setFireMask(fireMask & ~(1u << atoi(argv[0])));
+}
+} // eo cmdClear ::
+ 
+/*>>> cmdService: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		$SRV,1 puts the controller in service mode and $SRV,0 takes it out.
+Input: 		char argc, the number of arguments.
+char **argv, the argument fields.
+Returns:	None
+============================================================================*/
+void cmdService(char argc, char **argv)
+{
+if(argc >= 1)
+{
+serviceMode = atoi(argv[0]) != 0;
+}
+} // eo cmdService ::
+ 
+/*>>> cmdLock: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		$LCK,1 holds the door locked and $LCK,0 releases it.
+Input: 		char argc, the number of arguments.
+char **argv, the argument fields.
+Returns:	None
+============================================================================*/
+void cmdLock(char argc, char **argv)
+{
+if(argc >= 1)
+{
+lockCmd = atoi(argv[0]) != 0;
+}
+} // eo cmdLock ::
+ 
+/*>>> cmdStatus: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		$STS replies with $STS,fire,service,lock,duty,drops,depth: the 
+fire channels in alarm, the service and lock commands, the duty 
+cycle, and the sentences dropped by queueSen and the deepest the 
+transmit ring has been, so a saturated link shows up in the field.
+Input: 		char argc, the number of arguments.
+char **argv, the argument fields.
+Returns:	None
+============================================================================*/
+void cmdStatus(char argc, char **argv)
+{
+char sentence[STSSIZE];
+sprintf(sentence, "$STS,%u,%d,%d,%d,%u,%u\r", fireMask, (int)serviceMode, (int)lockCmd, 
+(int)dutyCycle, txDrops, (unsigned int)txDepthMax);
+queueSen(sentence);
+} // eo cmdStatus ::
+ 
+ 
+/*>>> driveLat: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		This function sets or clears the bits of mask in an output latch 
+with the high priority interrupts held off, as lockdown writes the 
+same latches.
+Input: 		volatile near unsigned char *lat, the latch.
+unsigned char mask, the bits to drive.
+char on, TRUE to set them, FALSE to clear them.
+Returns:	None
+============================================================================*/
+void driveLat(volatile near unsigned char *lat, unsigned char mask, char on)
+{
+INTCONbits.GIEH = FALSE;
+if(on)
+{
+*lat |= mask;
+}
+else
+{
+*lat &= ~mask;
+}
+INTCONbits.GIEH = TRUE;
+} // eo driveLat ::
+ 
+/*>>> zoneInput: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		This function reads an input of a zone, which is closed when low.
+Input: 		char zone, the zone.
+unsigned char mask, the input in the zone's port, 0 for none.
+Returns:	char, TRUE if the input is closed.
+============================================================================*/
+char zoneInput(char zone, unsigned char mask)
+{
+return mask && !(*zoneTable[zone].inPort & mask);
+} // eo zoneInput ::
+ 
+/*>>> setLock: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		This function locks or unlocks the door of a zone with the high 
+priority interrupts held off, as lockdown writes the same latches. 
+An unlock is dropped while lockActive is set, so a lockdown that 
+came after the caller read the decision is never undone.
+Input: 		char zone, the zone.
+char locked, TRUE to lock the door.
+Returns:	None
+============================================================================*/
+void setLock(char zone, char locked)
+{
+const rom zoneDesc_t *desc = &zoneTable[zone];
+INTCONbits.GIEH = FALSE;
+if(locked)
+{
+*desc->lockLat &= ~desc->lockMask;
+}
+else if(!lockActive)
+{
+*desc->lockLat |= desc->lockMask;
+}
+INTCONbits.GIEH = TRUE;
+} // eo setLock ::
+ 
+/*>>> setTray: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		This function starts the tray of a zone down (securing) or up 
+(exposing), or stops it. A ZONE_PWM tray starts on a RAMPUP ramp or 
+stops on a RAMPDOWN ramp; the high side enable of the direction is 
+switched on here and the ISR releases it once the motor is at rest, 
+so a travel only starts from rest. lockdown, limitISR and rampPWM 
+write the same variables and outputs, so they are updated with the 
+high priority interrupts held off. A ZONE_RELAY tray is switched 
+straight on or off.
+Input: 		char zone, the zone.
+char dir, TRAY_DOWN, TRAY_UP or FALSE to stop.
+Returns:	None
+============================================================================*/
+void setTray(char zone, char dir)
+{
+const rom zoneDesc_t *desc = &zoneTable[zone];
+if(desc->drive == ZONE_RELAY)
+{
+driveLat(desc->motorLat, desc->lowerMask | desc->raiseMask, FALSE);
+if(dir)
+{
+driveLat(desc->motorLat, (dir == TRAY_DOWN) ? desc->lowerMask : desc->raiseMask, TRUE);
+}
+return;
+}
+INTCONbits.GIEH = FALSE;
+LEDFWD = (dir == TRAY_DOWN);
+LEDREV = (dir == TRAY_UP);
+if(!dir)
+{
+pwmTarget = 0;
+}
+else
+{
+pwmTarget = PWMMAX;
+motorDir = dir;
+runSum = 0;
+runCount = 0;
+M1FWD = (dir == TRAY_DOWN);
+M1REV = (dir == TRAY_UP);
+PIE1bits.ADIE = TRUE; // watching the motor current
+}
+INTCONbits.GIEH = TRUE;
+} // eo setTray ::
+ 
+/*>>> enterTray: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		This function moves the tray state machine of a zone to a new state,
+sets the motors for it and starts the state's timeout. A travel is 
+marked fromLimit when it starts at the opposite limit switch, as 
+only such a travel times the full stroke.
+Input: 		char zone, the zone.
+char state, the new state.
+Returns:	None
+============================================================================*/
+void enterTray(char zone, char state)
+{
+zones[zone].state = state;
+zones[zone].tick = getTicks();
+zones[zone].fromLimit = FALSE;
+if(state == TRAY_LOWERING)
+{
+zones[zone].fromLimit = zoneInput(zone, zoneTable[zone].upMask);
+setTray(zone, TRAY_DOWN);
+}
+else if(state == TRAY_RAISING)
+{
+zones[zone].fromLimit = zoneInput(zone, zoneTable[zone].downMask);
+setTray(zone, TRAY_UP);
+}
+else
+{
+setTray(zone, FALSE);
+}
+} // eo enterTray ::
+ 
+/*>>> travelLimit: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		This function gives the longest a travel of a zone may take: its 
+learned nominal plus a quarter and STALLGRACE, or LOWERTICKS or 
+RAISETICKS until a nominal has been learned.
+Input: 		char zone, the zone.
+char dir, TRAY_DOWN or TRAY_UP.
+Returns:	unsigned int, the limit in ticks.
+============================================================================*/
+unsigned int travelLimit(char zone, char dir)
+{
+unsigned int nominal = zones[zone].nominal[dir - 1];
+unsigned int limit = (dir == TRAY_DOWN) ? LOWERTICKS : RAISETICKS;
+if(nominal && nominal + (nominal >> STALLSHIFT) + STALLGRACE < limit)
+{
+limit = nominal + (nominal >> STALLSHIFT) + STALLGRACE;
+}
+return limit;
+} // eo travelLimit ::
+ 
+/*>>> learnTravel: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		This function folds the time of a full travel, from one limit 
+switch to the other, into the nominal of its zone and direction; 
+the first one is taken as is. A travel that started part way, after
+a cut-short raise or a fault, would teach a short stroke, so trayStep
+only passes travels marked fromLimit. The nominal is kept at or over
+NOMFLOOR all the same.
+Input: 		char zone, the zone.
+char dir, TRAY_DOWN or TRAY_UP.
+unsigned int ticks, the time the travel took.
+Returns:	None
+============================================================================*/
+void learnTravel(char zone, char dir, unsigned int ticks)
+{
+unsigned int *nominal = &zones[zone].nominal[dir - 1];
+if(!*nominal)
+{
+*nominal = ticks;
+}
+else
+{
+*nominal += ((int)ticks - (int)*nominal) / NOMWEIGHT;
+}
+if(*nominal < NOMFLOOR)
+{
+*nominal = NOMFLOOR;
+}
+} // eo learnTravel ::
+ 
+/*>>> learnCurrent: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		This function folds the mean full duty current of a full travel of 
+the ZONE_PWM tray into its running current for the direction, the 
+way learnTravel folds the travel time, and sets the stallLimit 
+adcISR trips at to that plus a half and CURRENTGRACE. The first 
+full travel in each direction commissions the current check.
+Input: 		char dir, TRAY_DOWN or TRAY_UP.
+Returns:	None
+============================================================================*/
+void learnCurrent(char dir)
+{
+unsigned long sum = 0;
+unsigned int count = 0;
+unsigned int mean = 0;
+unsigned int *learned = &runCurrent[dir - 1];
+INTCONbits.GIEH = FALSE;
+sum = runSum;
+count = runCount;
+INTCONbits.GIEH = TRUE;
+if(!count)
+{
+return; //never reached full duty
+}
+mean = sum / count;
+if(!*learned)
+{
+*learned = mean;
+}
+else
+{
+*learned += ((int)mean - (int)*learned) / NOMWEIGHT;
+}
+INTCONbits.GIEH = FALSE;
+stallLimit[dir - 1] = *learned + (*learned >> CURRENTSHIFT) + CURRENTGRACE;
+INTCONbits.GIEH = TRUE;
+} // eo learnCurrent ::
+ 
+/*>>> trayFault: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		This function cuts the motor of a travel that stalled or overran and
+reports it in a fault frame: seq, zone, cause (FLT_TIME or 
+FLT_CURRENT), direction, ticks travelled and the last motor current,
+values high byte first. Only the ZONE_PWM tray senses its current;
+the others report 0.
+Input: 		char zone, the zone.
+char dir, TRAY_DOWN or TRAY_UP.
+unsigned int elapsed, the ticks travelled.
+Returns:	None
+============================================================================*/
+void trayFault(char zone, char dir, unsigned int elapsed)
+{
+unsigned char payload[8];
+unsigned int current = 0;
+char cause = FLT_TIME;
+if(zoneTable[zone].drive == ZONE_PWM)
+{
+INTCONbits.GIEH = FALSE;
+cutMotor();
+current = motorCurrent;
+INTCONbits.GIEH = TRUE;
+if(stallCause)
+{
+cause = stallCause;
+}
+stallCause = FALSE;
+}
+payload[0] = ++evacSeq;
+payload[1] = zone;
+payload[2] = cause;
+payload[3] = dir;
+payload[4] = elapsed >> BYTESIZE;
+payload[5] = elapsed;
+payload[6] = current >> BYTESIZE;
+payload[7] = current;
+queueFrame(EVACNODE, FRM_FLT, payload, sizeof(payload));
+zones[zone].faults++;
+enterTray(zone, TRAY_FAULT);
+} // eo trayFault ::
+ 
+/*>>> trayStep: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		This function advances the tray of a zone by one step per tick, so 
+the controller keeps serving the link and its inputs while the 
+motors run. A securing demand is latched until the tray reaches the 
+bottom limit, as the old downFlag was: while latched the tray is 
+lowered, a raise is cut short and runZones keeps the door locked. A 
+lowering the lockdown ISR has started is taken over in whatever state
+the zone is in, so the ISR's ramp is never cancelled, and is timed 
+from the tick the ISR started it. Remote access 
+with no securing demand raises the tray to the top limit, with the 
+door unlocked. Like the old loops, a travel carries on to its limit once 
+started. A travel that outlasts travelLimit, or whose motor current 
+shows a stall, is cut and reported by trayFault and waits in 
+TRAY_FAULT until the demand that started it drops. The time each 
+lowering takes to secure the artifact, ramps included, is kept in 
+secureTime and the worst in secureTimeMax. Only travels that began
+at the opposite limit switch teach learnTravel and, for the 
+ZONE_PWM tray, learnCurrent.
+Input: 		char zone, the zone.
+char secure, TRUE while the artifact must be secured.
+Returns:	None
+============================================================================*/
+void trayStep(char zone, char secure)
+{
+zone_t *z = &zones[zone];
+const rom zoneDesc_t *desc = &zoneTable[zone];
+char pwm = (desc->drive == ZONE_PWM);
+char stalled = pwm && stallCause;
+unsigned int elapsed = getTicks() - z->tick;
+if(secure)
+{
+z->latched = TRUE;
+}
+else if(zoneInput(zone, desc->downMask) || z->state == TRAY_FAULT)
+{
+z->latched = FALSE; //the tray is down, or its lowering failed, and the demand has dropped
+}
+if(pwm && z->state != TRAY_LOWERING && motorDir == TRAY_DOWN && pwmTarget) //lowering started by the ISR
+{
+INTCONbits.GIEH = FALSE;
+z->tick = lowerTick;
+z->fromLimit = lowerFromTop;
+INTCONbits.GIEH = TRUE;
+z->state = TRAY_LOWERING;
+z->latched = TRUE;
+elapsed = getTicks() - z->tick;
+}
+switch(z->state)
+{
+case TRAY_STOPPED:
+if(pwm && motorDir) //still ramping down
+{
+break;
+}
+if(z->latched && !zoneInput(zone, desc->downMask))
+{
+enterTray(zone, TRAY_LOWERING);
+}
+else if(!z->latched && REMOX && !zoneInput(zone, desc->upMask))
+{
+enterTray(zone, TRAY_RAISING);
+}
+break;
+ 
+case TRAY_LOWERING:
+if(zoneInput(zone, desc->downMask)) //artifact is secured
+{
+z->secureTime = elapsed * TICKMS;
+if(z->secureTime > z->secureTimeMax)
+{
+z->secureTimeMax = z->secureTime;
+}
+if(z->fromLimit)
+{
+learnTravel(zone, TRAY_DOWN, elapsed);
+if(pwm)
+{
+learnCurrent(TRAY_DOWN);
+}
+}
+enterTray(zone, TRAY_STOPPED);
+}
+else if(stalled || elapsed >= travelLimit(zone, TRAY_DOWN))
+{
+trayFault(zone, TRAY_DOWN, elapsed);
+}
+break;
+ 
+case TRAY_RAISING:
+if(zoneInput(zone, desc->upMask)) //artifact is exposed
+{
+if(z->fromLimit)
+{
+learnTravel(zone, TRAY_UP, elapsed);
+if(pwm)
+{
+learnCurrent(TRAY_UP);
+}
+}
+enterTray(zone, TRAY_STOPPED);
+}
+else if(z->latched) //artifact must be secured, ramping down before lowering
+{
+enterTray(zone, TRAY_STOPPED);
+}
+else if(stalled || elapsed >= travelLimit(zone, TRAY_UP))
+{
+trayFault(zone, TRAY_UP, elapsed);
+}
+break;
+ 
+default:
+if(!secure && !REMOX)
+{
+enterTray(zone, TRAY_STOPPED);
+}
+break;
+}
+} // eo trayStep ::
+ 
+/*>>> runZones: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		This function runs the state machine of every zone once. A zone is 
+secured by the interlock decision, by its $ZSR command or by its 
+case sensor. Its door lock is then worked out once from the tray and
+the commands and written with a single setLock: locked while a 
+securing demand is latched or $LCK or its $ZLK command holds it, 
+otherwise unlocked by a DEC_UNLOCK decision or a raise, otherwise 
+left as it was. Each zone is a fixed amount of work, so a pass grows by one
+zone's cost per row of zoneTable; the cycles of each zone and of the
+whole pass are measured with Timer1 and a pass over ZONEBUDGET is 
+counted in schedOverruns.
+Input: 		char act, the interlock decision of the last port snapshot.
+Returns:	None
+============================================================================*/
+void runZones(char act)
+{
+char zone = 0;
+char secure = FALSE;
+unsigned int start = readTMR1();
+unsigned int zoneStart = 0;
+unsigned int cycles = 0;
+for(zone = 0; zone < ZONECOUNT; zone++)
+{
+zoneStart = readTMR1();
+secure = (act & DEC_SECURE) || zones[zone].secureCmd || 
+zoneInput(zone, zoneTable[zone].caseMask);
+trayStep(zone, secure);
+if(zones[zone].latched || lockCmd || zones[zone].lockCmd)
+{
+zones[zone].locked = TRUE;
+}
+else if((act & DEC_UNLOCK) || zones[zone].state == TRAY_RAISING)
+{
+zones[zone].locked = FALSE;
+}
+setLock(zone, zones[zone].locked);
+cycles = readTMR1() - zoneStart;
+if(cycles > zoneCyclesMax[zone])
+{
+zoneCyclesMax[zone] = cycles;
+}
+}
+schedCycles = readTMR1() - start;
+if(schedCycles > schedCyclesMax)
+{
+schedCyclesMax = schedCycles;
+}
+if(schedCycles > ZONEBUDGET)
+{
+schedOverruns++;
+}
+} // eo runZones ::
+ 
+/*>>> cmdHistogram: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		$HST replies with $HST,b0,...,b9,edge,poll: the lockdown latency 
+counts of each bin, bin 0 under 32us and each next bin twice as wide,
+then the worst latency in microseconds of an INT0 edge and of a 
+sampled input.
+Input: 		char argc, the number of arguments.
+char **argv, the argument fields.
+Returns:	None
+============================================================================*/
+void cmdHistogram(char argc, char **argv)
+{
+char sentence[HSTSIZE];
+char len = 0;
+char bin = 0;
+strcpypgm2ram(sentence, "$HST");
+len = strlen(sentence);
+for(bin = 0; bin < LATBINS; bin++)
+{
+len += sprintf(sentence + len, ",%u", lockHist[bin]);
+}
+sprintf(sentence + len, ",%u,%u\r", lockLatMax[LAT_EDGE], lockLatMax[LAT_POLL]);
+queueSen(sentence);
+} // eo cmdHistogram ::
+ 
+/*>>> zoneArg: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		This function reads the zone a zone command addresses from its first
+argument, counting a missing or unknown zone in cmdErrors.
+Input: 		char argc, the number of arguments.
+char **argv, the argument fields.
+char need, the number of arguments the command takes.
+Returns:	char, the zone, or -1 if the command is rejected.
+============================================================================*/
+char zoneArg(char argc, char **argv, char need)
+{
+int zone = 0;
+if(argc < need)
+{
+cmdErrors++;
+return -1;
+}
+zone = atoi(argv[0]);
+if(zone < 0 || zone >= ZONECOUNT)
+{
+cmdErrors++;
+return -1;
+}
+return zone;
+} // eo zoneArg ::
+ 
+/*>>> cmdZoneSecure: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		$ZSR,z,1 secures zone z whatever the interlocks decide and $ZSR,z,0 
+hands it back to them.
+Input: 		char argc, the number of arguments.
+char **argv, the argument fields.
+Returns:	None
+============================================================================*/
+void cmdZoneSecure(char argc, char **argv)
+{
+char zone = zoneArg(argc, argv, 2);
+if(zone >= 0)
+{
+zones[zone].secureCmd = atoi(argv[1]) != 0;
+}
+} // eo cmdZoneSecure ::
+ 
+/*>>> cmdZoneLock: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		$ZLK,z,1 holds the door of zone z locked and $ZLK,z,0 releases it.
+Input: 		char argc, the number of arguments.
+char **argv, the argument fields.
+Returns:	None
+============================================================================*/
+void cmdZoneLock(char argc, char **argv)
+{
+char zone = zoneArg(argc, argv, 2);
+if(zone >= 0)
+{
+zones[zone].lockCmd = atoi(argv[1]) != 0;
+}
+} // eo cmdZoneLock ::
+ 
+/*>>> cmdZoneStatus: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		$ZST,z replies with $ZST,z,state,lock,secure,faults,secure time,
+zone cycles,pass cycles,overruns: the tray state, the $ZLK and $ZSR 
+commands, the faults and worst time to secure (ms) of zone z, its 
+worst cycles per tick and the worst cycles and overruns of a pass 
+of all zones.
+Input: 		char argc, the number of arguments.
+char **argv, the argument fields.
+Returns:	None
+============================================================================*/
+void cmdZoneStatus(char argc, char **argv)
+{
+char sentence[ZSTSIZE];
+char zone = zoneArg(argc, argv, 1);
+if(zone < 0)
+{
+return;
+}
+sprintf(sentence, "$ZST,%d,%d,%d,%d,%u,%u,%u,%u,%u\r", (int)zone, (int)zones[zone].state, 
+(int)zones[zone].lockCmd, (int)zones[zone].secureCmd, zones[zone].faults, 
+zones[zone].secureTimeMax, zoneCyclesMax[zone], schedCyclesMax, schedOverruns);
+queueSen(sentence);
+} // eo cmdZoneStatus ::
+ 
+ 
+/*>>> checkDecisions: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		Run once at start up, this function walks every level of the six
+interlock inputs, builds the port bytes they would be read from and 
+looks them up in decisionTable through PACKINDEX, as interlockISR 
+does. The expected outcome comes from the rules of the old main loop,
+in their old order and independent of DECIDE: intruder or service 
+mode unlocked the door, then the securing loop locked it over that.
+Every mismatch is counted in decisionErrors and $DCK,errors reports 
+the result, so each boot of the node checks its table.
+Input: 		None
+Returns:	None
+============================================================================*/
+void checkDecisions(void)
+{
+char combo = 0;
+char intruder = 0;
+char remox = 0;
+char talarm = 0;
+char breach = 0;
+char fire = 0;
+char service = 0;
+unsigned char portB = 0;
+unsigned char portC = 0;
+unsigned char portD = 0;
+char expect = 0;
+char sentence[BUFSIZE];
+for(combo = 0; combo < DECISIONS; combo++) //one bit per input, in any order
+{
+intruder = (combo & 0x01) != 0;
+remox = (combo & 0x02) != 0;
+talarm = (combo & 0x04) != 0;
+breach = (combo & 0x08) != 0;
+fire = (combo & 0x10) != 0;
+service = (combo & 0x20) != 0;
+portB = intruder ? 0x01 : 0x00; //RB0
+portC = talarm ? 0x80 : 0x00; //RC7
+portD = (remox ? 0x20 : 0x00) | (breach ? 0x10 : 0x00); //RD5 and RD4
+expect = 0;
+if(intruder || service) //if(INTRUDER||serviceMode) DLOCK = TRUE;
+{
+expect = DEC_UNLOCK;
+}
+if((!intruder && !remox) || fire || talarm || breach) //the securing while loop
+{
+expect = DEC_SECURE;
+}
+if(decisionTable[PACKINDEX(portB, portC, portD, fire, service)] != expect)
+{
+decisionErrors++;
+}
+}
+sprintf(sentence, "$DCK,%u\r", decisionErrors);
+queueSen(sentence);
+} // eo checkDecisions ::
+ 
+/*--- MAIN: FUNCTION ----------------------------------------------------------
+----------------------------------------------------------------------------*/
+void main( void )
+{
+unsigned int now = 0;
+systemInitialization(); //configures the system as per operation requirements 
+checkDecisions(); //every boot, reported in $DCK
+ 
+while(1)
+{
+pollRX(); //taking the received bytes out of the receive ring
+if(frameRdy)
+{
+setFireMask(checkFireFrame(fireMask)); //checking the recieved frame from fire detection system 
+relayFrame(); //forwarding it to the panel and logger
+frameRdy = FALSE;
+}
+if(sentenceRdy)
+{
+receivedSen(); //relaying the sentence before it is split
+dispatchSen(); //acting on the command
+sentenceRdy = FALSE;
+}
+ 
+now = getTicks();
+if(now != zoneTick) //running every zone once per tick
+{
+zoneTick = now;
+runZones(decision); //the interlocks of the last port snapshot
+}
+ 
+reportDuty();
+if(rxTail == rxHead)
+{
+idleUntilWake(); //waiting for the next tick, received byte or intruder edge
+}
 }//eo indefinite loop
  
 } // eo main::
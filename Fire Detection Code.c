@@ -40,17 +40,28 @@ mechanisms when thresholds are exceeded.
 #include <stdio.h>
 #include <stdlib.h>
 #include <usart.h>
+#include <string.h>
+#include "nodeFrame.h"
+#include "nodePower.h"
+#include "nodeIsr.h"
  
 // Constants  =================================================================
 #define TRUE			1	
 #define FALSE			0
-#define HUNDREDMILSEC 	0x3CB0
-#define T0FLAG 			INTCONbits.TMR0IF
+#define T2FLAG 			PIR1bits.TMR2IF
+#define T2TENMILSEC 	0x4D	// Timer2 on, 1:4 prescale, 1:10 postscale
+#define PR2TENMILSEC 	249	// 10ms tick with T2TENMILSEC at 4MHz
+#define TICKMS 			10	// milliseconds per scheduler tick
 #define BYTESIZE 		8
 #define SAMPLESIZE 		5
 #define SENCOUNT 		2
-#define ONESEC 			10	
+#if SENCOUNT > FIRECHMAX
+#error "the evacuation node keeps FIRECHMAX fire channels at most"
+#endif
 #define ADCRES 			0.0048828125
+#define ADCVREF 		5	// ADC full scale reference (volts)
+#define ADCCOUNTS 		1024	// 10 bit converter
+#define QSHIFT 			10	// fraction bits of the Q-format coefficients
 #define SMOKE 			0
 #define FLAME 			1
 #define SMOKEM 			300
@@ -58,31 +69,192 @@ mechanisms when thresholds are exceeded.
 #define FLAMEM			6
 #define SMOKEL 			2000 // ppm
 #define FLAMEL 			2  //meters
+#define SMOKER 			400 // ppm per second
+#define FLAMER 			1  //meters per second
+#define SMOKEH 			100 // ppm below SMOKEL before the alarm clears
+#define FLAMEH 			0  //meters below FLAMEL before the alarm clears
+#define RISESPAN 		25	// fast windows in the slope span (1 second)
+#define RISEHOLD 		125	// fast windows a rate alarm is held (5 seconds)
+#define DET_LEVEL 		'L'	// alarm raised by the level detector
+#define DET_RATE 		'R'	// alarm raised by the rate of rise detector
+#define ST_NORMAL 		0	// channel below its limit
+#define ST_PREALARM 	1	// over the limit, waiting for raiseN of persistM windows
+#define ST_ALARM 		2	// alarm raised
+#define ST_CLEARING 	3	// under the band, waiting for clearN of persistM windows
 #define ALARM			LATCbits.LATC3
 #define MOTOR			LATCbits.LATC2
-#define SMOKE_FLAG		LATDbits.LATD6
-#define FLAME_FLAG      LATDbits.LATD7
+#define SMOKE_MASK		0x40	// RD6 smoke flag output
+#define FLAME_MASK      0x80	// RD7 flame flag output
 #define BUFSIZE			20
+#define ADCFLAG 		PIR1bits.ADIF
+#define INTGON 			0xC0	// GIEH and GIEL
+#define TMR2MASK 		0x02	// TMR2IF in PIR1, TMR2IE in PIE1
+#define TX1MASK 		0x10	// TX1IF in PIR1, TX1IE in PIE1
+#define ADCMASK 		0x40	// ADIF in PIR1, ADIE in PIE1
+#define ADCWINDOW 		4	// longest fast window, in samples
+#define LATENCYTARGET 	250	// stimulus to alarm target (ms)
+#define SMOKEDIV 		1	// smoke sampled every tick (100Hz)...
+#define SMOKELEN 		4	// ...in 40ms fast windows
+#define FLAMEDIV 		2	// flame sampled every other tick (50Hz)...
+#define FLAMELEN 		2	// ...in 40ms fast windows
+#define RAISEN 			4	// over windows that raise the alarm...
+#define CLEARN 			8	// ...or under windows that clear it...
+#define PERSISTM 		8	// ...out of the last PERSISTM windows
+#define SLOWLEN 		25	// fast windows per reporting value (1 second)
+// Worst stimulus to alarm time of a channel: the stimulus sample opens a 
+// window whose average may still be under the limit, RAISEN whole windows
+// over it follow, and the foreground reads the last one within a tick.
+#define WORSTLATENCY(div, len) 	((((len) - 1) * (div) + RAISEN * (len) * (div) + 1) * TICKMS)
+#if WORSTLATENCY(SMOKEDIV, SMOKELEN) > LATENCYTARGET || WORSTLATENCY(FLAMEDIV, FLAMELEN) > LATENCYTARGET
+#error "fast windows and RAISEN miss LATENCYTARGET"
+#endif
+#define TXSIZE 			64	// transmit ring size, a power of 2
+#define TXMASK 			(TXSIZE - 1)
+#define TXFLAG 			PIR1bits.TX1IF
+#define REPORTTICKS 	100	// ticks between sensor frames (1s)
+#define DUTYTICKS 		100	// ticks per duty cycle figure (1s)
+#define TICKCYCLES 		10000	// instruction cycles per tick at 4MHz
+#define FILTER_MEAN 	0	// running sum over the last SAMPLESIZE samples
+#define FILTER_EWMA 	1	// exponential average, weight 1/2^EWMASHIFT
+#define FILTER_MEDIAN 	2	// median of the last MEDIANSIZE samples
+#define EWMASHIFT 		2
+#define MEDIANSIZE 		3	// odd, no larger than SAMPLESIZE
  
+// Q-format coefficients ======================================================
+// Each channel converts its averaged ADC count with phys = (avg*m + b) >> QSHIFT,
+// where m folds ADCRES into the sensor slope. With ADCCOUNTS = 2^QSHIFT the 
+// slope is an exact integer, so the result equals the truncated float result;
+// for a non-integer slope the error stays within 1 unit of the output.
+#define QSCALE(m) 		(((long)(m) * ADCVREF << QSHIFT) / ADCCOUNTS)
+#define QOFFSET(b) 		((long)(b) << QSHIFT)
+// smallest ADC count whose converted value is above limit l
+#define QTRIP(l, m, b) 	((QOFFSET((l) + 1) - QOFFSET(b) + QSCALE(m) - 1) / QSCALE(m))
+
 // Global Variables  ==========================================================
  
 typedef int sensor_t; //data type for raw data from sensors
  
+// Everything the sampling and evaluation loop needs to know about a channel.
+// Adding a sensor means adding a row to chanTable and raising SENCOUNT.
+typedef struct 
+{
+char adcCh; //ADC channel
+long scale; //Q-format slope, QSCALE()
+long offset; //Q-format offset, QOFFSET()
+sensor_t limit; //alarm level
+sensor_t hyst; //distance below limit at which the alarm clears
+sensor_t riseLimit; //rise over RISESPAN that raises a rate alarm
+sensor_t rawTrip; //raw ADC count that marks the stimulus, QTRIP()
+char filter; //FILTER_MEAN, FILTER_EWMA or FILTER_MEDIAN
+char sampleDiv; //ticks between samples
+char fastLen; //samples per fast detection window
+char slowLen; //fast windows per slow reporting value
+char raiseN; //windows over the limit that raise the alarm...
+char clearN; //...or under limit-hyst that clear it...
+char persistM; //...out of the last persistM windows (8 at most)
+volatile near unsigned char *flagLat; //latch of the flag output
+char flagMask; //bit of the flag output
+} chanDesc_t;
+ 
+const rom chanDesc_t chanTable[SENCOUNT] = 
+{
+//smoke: C = 1940*V+300 ppm, sampled at 100Hz
+{SMOKE, QSCALE(SMOKEB), QOFFSET(SMOKEM), SMOKEL, SMOKEH, SMOKER, 
+QTRIP(SMOKEL, SMOKEB, SMOKEM), FILTER_MEAN, SMOKEDIV, SMOKELEN, SLOWLEN, 
+RAISEN, CLEARN, PERSISTM, &LATD, SMOKE_MASK},
+//flame: D = 6*V meters, sampled at 50Hz
+{FLAME, QSCALE(FLAMEM), QOFFSET(0), FLAMEL, FLAMEH, FLAMER, 
+QTRIP(FLAMEL, FLAMEM, 0), FILTER_MEAN, FLAMEDIV, FLAMELEN, SLOWLEN, 
+RAISEN, CLEARN, PERSISTM, &LATD, FLAME_MASK}
+};
+ 
 typedef struct 
 {
 sensor_t sample[SAMPLESIZE];
-sensor_t avg;
+sensor_t slowRaw; //slow path filter output, in ADC counts
+sensor_t avg; //slow path converted to the channel units, filtered once per second
+sensor_t fast; //fast path, one value per fast window
 sensor_t duckLimit;
+long slowSum; //fast windows waiting to be decimated into the slow path
+char slowCount;
+sensor_t rise[RISESPAN]; //fast values over the slope span
+char riseInsert;
+char riseFull;
+char riseHold; //fast windows left on a rate alarm
+sensor_t riseLimit; //rise over RISESPAN that raises a rate alarm
+long sum; //running sum of sample[]
+long ewma; //EWMA state scaled by 2^EWMASHIFT
+char mode; //FILTER_MEAN, FILTER_EWMA or FILTER_MEDIAN
 char insert;
 char avgReady;
-char smokeFlag;
-char flameFlag;
+char state; //ST_NORMAL, ST_PREALARM, ST_ALARM or ST_CLEARING
+unsigned char persist; //windows that met the pending transition, newest in bit 0
 } sensorCh_t; 
  
 sensorCh_t sensors[SENCOUNT];
  
+typedef struct 
+{
+sensor_t win[2][ADCWINDOW]; //double buffered sample windows
+char fill; //window being filled by the ISR
+char count; //samples in the filling window
+char ready; //TRUE while the other window holds unread samples
+char overrun; //windows completed before the previous one was read
+char due; //ticks left before the next sample
+char sampling; //TRUE while a sample is owed to this ring
+char stimulus; //TRUE once a raw sample above the trip count is seen
+char hot; //TRUE when the filling window has a sample above the trip count
+unsigned int stimTick; //tick of that sample
+} adcRing_t;
+ 
+volatile adcRing_t adcRings[SENCOUNT];
+volatile char scanPos = SENCOUNT; //position of the conversion in progress
+ 
+unsigned int alarmLatency[SENCOUNT]; //last stimulus to alarm time (ms)
+unsigned int latencyMax = 0; //worst stimulus to alarm time seen (ms)
+char latencyOk = TRUE; //FALSE once latencyMax exceeds LATENCYTARGET
+char activeCount = 0; //channels holding the alarm
+unsigned int loopCycles = 0; //cycles of the last evaluation pass
+unsigned int loopCyclesMax = 0; //worst evaluation pass
+unsigned int chanCycles = 0; //cycles per channel evaluated in the last pass
+unsigned int chanCyclesMax = 0; //worst cost of one channel, what SENCOUNT scales
+ 
+#ifdef CONVBENCH
+unsigned int convCycles[2]; // cycles used by the fixed [0] and float [1] paths
+#endif
+ 
 char receivingBuf[BUFSIZE] = {0};
  
+unsigned char txBuf[TXSIZE]; //transmit ring, filled by queueTX and emptied by the ISR
+volatile char txHead = 0; //next free slot, written by the foreground only
+volatile char txTail = 0; //next byte to send, written by the ISR only
+unsigned int txDrops = 0; //frames dropped because the ring was full
+unsigned char txSeq = 0; //sequence number of the last frame
+unsigned int lastTxTick = 0; //tick of the last sensor frame
+ 
+// Prototypes
+ 
+void tickISR(void);
+void txISR(void);
+void adcISR(void);
+ 
+// Interrupt sources ===========================================================
+// Dispatched by nodeIsr.c, each table ends with a NULL handler.
+// timebase on the high vector
+const rom isrSource_t highTable[] = 
+{
+{&PIR1, TMR2MASK, &PIE1, TMR2MASK, tickISR},
+{NULL, 0, NULL, 0, NULL}
+};
+ 
+// serial link and conversions on the low vector
+const rom isrSource_t lowTable[] = 
+{
+{&PIR1, TX1MASK, &PIE1, TX1MASK, txISR},
+{&PIR1, ADCMASK, &PIE1, ADCMASK, adcISR},
+{NULL, 0, NULL, 0, NULL}
+};
+ 
 // Functions  =================================================================
  
 /*>>> SetOSC4MHz: ===========================================================
@@ -149,52 +321,38 @@ ADCON2	= 0XA9;
 Author:	Vaibhav Sinha
 Date:		11/06/2024
 Modified:	None
-Desc:		This function sets the USART1 for  9600 baud rate, SP1 on, TX & RX 
-enabled, 8 bit, 1 stop bit, non-inverted.
+Desc:		This function sets the USART1 for 38.4k baud rate (16 bit BRG, 
+0.16% error at 4MHz), SP1 on, TX & RX enabled, 8 bit, 1 stop bit, 
+non-inverted.
 Input: 		None
 Returns:	None
 ============================================================================*/
 void configUSART(void)
 {
-BAUDCON1 	= 0X40;
+BAUDCON1 	= 0X48;
 TXSTA1	= 0X26;
 RCSTA1 	= 0X90;
-SPBRG1 	= 12;
+SPBRG1 	= 25;
 SPBRGH	= 0;
  
 }// eo configUSART::
  
-/*>>> resetTMR0: ===========================================================
-Author:	Vaibhav Sinha
-Date:		11/06/2024
-Modified:	None
-Desc:		This function resets the timer0 after the rollover time is passed.
-Input: 		int psc, the prescale value according to the desired rollover time.
-Returns:	None
-============================================================================*/
-void resetTMR0(int psc)
-{
-T0FLAG 	= FALSE;
-TMR0H 	= psc >> BYTESIZE;
-TMR0L 	= psc;
- 
-}// eo resetTMR0::
- 
-/*>>> configTMR0: ===========================================================
-Author:	Vaibhav Sinha
-Date:		11/06/2024
+/*>>> configTMR2: ===========================================================
+Author:	
+Date:		
 Modified:	None
-Desc:		This function sets the Timer0 module of the microcontroller 
-PIC18F45K22 for100ms rollover, Timer0 on, prescaler as needed.
-Input: 		int psc, the prescale value according to the desired rollover time.
+Desc:		This function sets the Timer2 module of the microcontroller 
+PIC18F45K22 for the 10ms scheduler tick.
+Input: 		None
 Returns:	None
 ============================================================================*/
-void configTMR0(int psc)
+void configTMR2(void)
 {
-resetTMR0(psc);
-T0CON = 0X90;
+TMR2 = FALSE;
+PR2 = PR2TENMILSEC;
+T2CON = T2TENMILSEC;
  
-}// eo configTMR0::
+}// eo configTMR2::
  
 /*>>> initSensorCh: ===========================================================
 Author:	Vaibhav Sinha
@@ -204,55 +362,654 @@ Desc:		This function will initialize all the elements of the data structure
 sensorCh_t
 Input: 		sensorCh_t *sen, pointer that will be used to address all elements 
 of the data structure sensorCh_t.
+const rom chanDesc_t *desc, the table row of the channel.
 Returns:	None
 ============================================================================*/
-void initSensorCh(sensorCh_t *sen)
+void initSensorCh(sensorCh_t *sen, const rom chanDesc_t *desc)
 {
 int index = 0;
 for (index = 0; index < SAMPLESIZE; index++)
 {
 sen -> sample[index] = FALSE;
 }
+sen -> slowRaw = FALSE;
 sen -> avg = FALSE;
-sensors[SMOKE].duckLimit = SMOKEL;
-sensors[FLAME].duckLimit = FLAMEL;
+sen -> fast = FALSE;
+sen -> slowSum = FALSE;
+sen -> slowCount = FALSE;
+sen -> sum = FALSE;
+sen -> ewma = FALSE;
+sen -> mode = desc -> filter;
+sen -> duckLimit = desc -> limit;
 sen -> insert = FALSE;
 sen -> avgReady = FALSE;
-sen-> smokeFlag = FALSE;
-sen-> flameFlag = FALSE;
+for (index = 0; index < RISESPAN; index++)
+{
+sen -> rise[index] = FALSE;
+}
+sen -> riseInsert = FALSE;
+sen -> riseFull = FALSE;
+sen -> riseHold = FALSE;
+sen -> riseLimit = desc -> riseLimit;
+sen -> state = ST_NORMAL;
+sen -> persist = FALSE;
 }// eo initSensorCh::
  
-/*>>> getADCSamle: ===========================================================
-Author:Vaibhav Sinha
-Date:		11/06/2024
+/*>>> medianOf: ===========================================================
+Author:	
+Date:		
 Modified:	None
-Desc:		This function takes the raw data from the input ports, converts 
-them binary readable values and stores them into a registor. 
-Input: 		char chID, this input specifies the port from which samples are to
-be taken.
+Desc:		This function sorts the newest MEDIANSIZE samples of a channel by
+insertion into a small local array and returns the middle one.
+Input: 		sensorCh_t *sen, the channel whose history is to be used.
+Returns:	sensor_t, the median of the newest samples.
+============================================================================*/
+sensor_t medianOf(sensorCh_t *sen)
+{
+sensor_t sorted[MEDIANSIZE];
+sensor_t value = 0;
+char pos = sen -> insert;
+char count = 0;
+char index = 0;
+for (count = 0; count < MEDIANSIZE; count++)
+{
+pos = (pos == 0 ? SAMPLESIZE : pos) - 1; //walking back from the newest
+value = sen -> sample[pos];
+for (index = count; index > 0 && sorted[index - 1] > value; index--)
+{
+sorted[index] = sorted[index - 1];
+}
+sorted[index] = value;
+}
+return sorted[MEDIANSIZE / 2];
+}// eo medianOf::
+ 
+/*>>> filterSample: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		This function adds a new sample to the channel history, replacing the
+oldest one in the running sum, and returns the channel's filtered value.
+The cost does not depend on SAMPLESIZE. avgReady is set once the 
+history has been filled for the first time.
+Input: 		sensorCh_t *sen, the channel the sample belongs to.
+sensor_t sample, the new sample.
+Returns:	sensor_t, the filtered value in the units of the samples.
+============================================================================*/
+sensor_t filterSample(sensorCh_t *sen, sensor_t sample)
+{
+sen -> sum += (long)sample - sen -> sample[sen -> insert];
+sen -> sample[sen -> insert] = sample;
+sen -> insert++;
+if (sen -> insert >= SAMPLESIZE)
+{
+sen -> insert = FALSE;
+sen -> avgReady = TRUE;
+}
+switch (sen -> mode)
+{
+case FILTER_EWMA:
+if (!sen -> avgReady && sen -> insert == 1)
+{
+sen -> ewma = (long)sample << EWMASHIFT; //seeding with the first sample
+}
+sen -> ewma += sample - (sen -> ewma >> EWMASHIFT);
+return sen -> ewma >> EWMASHIFT;
+ 
+case FILTER_MEDIAN:
+return medianOf(sen);
+ 
+default:
+return sen -> sum / SAMPLESIZE;
+}
+}// eo filterSample::
+ 
+/*>>> checkRise: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		This function adds the newest fast value of a channel to its slope 
+history and compares it against the value RISESPAN windows earlier. A
+rise above riseLimit raises a rate alarm that is held for RISEHOLD 
+windows after the last steep window, so a fast growing fire is caught
+before its level reaches duckLimit.
+Input: 		sensorCh_t *sen, the channel whose fast value has been updated.
+Returns:	char, TRUE while the rate alarm is held.
+============================================================================*/
+char checkRise(sensorCh_t *sen)
+{
+sensor_t oldest = sen -> rise[sen -> riseInsert];
+sen -> rise[sen -> riseInsert] = sen -> fast;
+sen -> riseInsert++;
+if (sen -> riseInsert >= RISESPAN)
+{
+sen -> riseInsert = FALSE;
+sen -> riseFull = TRUE;
+}
+if (sen -> riseFull && sen -> fast - oldest > sen -> riseLimit)
+{
+sen -> riseHold = RISEHOLD;
+}
+else if (sen -> riseHold)
+{
+sen -> riseHold--;
+}
+return sen -> riseHold > 0;
+}// eo checkRise::
+ 
+/*>>> configINTS: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		Initializes interrupts for Timer2 and the ADC so that conversions
+are started by the timer and collected in the ISR. The tick is high
+priority; the ADC and the transmitter are low priority.
+Input: 		None
+Returns:	None
+============================================================================*/
+void configINTS(void)
+{
+T2FLAG = FALSE;
+IPR1bits.TMR2IP = TRUE;
+PIE1bits.TMR2IE = TRUE; // Timer2 tick schedules the ADC scan
+ADCFLAG = FALSE;
+IPR1bits.ADIP = FALSE;
+PIE1bits.ADIE = TRUE; // ADC complete collects the result
+IPR1bits.TX1IP = FALSE; // enabled by queueTX
+ 
+RCONbits.IPEN = TRUE; // Global interrupt priority enabled
+INTCON |= INTGON; // Enable high and low priority interrupts
+}// eo configINTS::
+ 
+/*>>> startNextScan: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		This function moves scanPos to the next ring that is owed a sample
+and starts its conversion. Called from the interrupt handlers only.
+Input: 		None
 Returns:	None
 ============================================================================*/
-sensor_t getADCSample(char chID)
+void startNextScan(void)
 {
-ADCON0bits.CHS = chID;
+while(scanPos < SENCOUNT && !adcRings[scanPos].sampling)
+{
+scanPos++;
+}
+if(scanPos < SENCOUNT)
+{
+ADCON0bits.CHS = chanTable[scanPos].adcCh;
 ADCON0bits.GO = TRUE;
-while(ADCON0bits.GO);
-return ADRES;
-}// eo getADCSample::
+}
+}// eo startNextScan::
+ 
+/*>>> tickISR: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		On every 10ms Timer2 tick this function marks the rings whose sample
+divider has run out and starts a scan over them.
+Input: 		None
+Returns:	None
+============================================================================*/
+void tickISR(void)
+{
+char chID = 0;
+T2FLAG = FALSE;
+tickCount++;
+for (chID = 0; chID < SENCOUNT; chID++)
+{
+if(adcRings[chID].due <= 1)
+{
+adcRings[chID].due = chanTable[chID].sampleDiv;
+adcRings[chID].sampling = TRUE;
+}
+else
+{
+adcRings[chID].due--;
+}
+}
+if(scanPos >= SENCOUNT) //previous scan finished
+{
+scanPos = 0;
+startNextScan();
+}
+}// eo tickISR::
+ 
+/*>>> txISR: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		This function feeds USART1 from the transmit ring and disables the 
+transmitter interrupt once the ring is drained.
+Input: 		None
+Returns:	None
+============================================================================*/
+void txISR(void)
+{
+if(txTail != txHead)
+{
+TXREG1 = txBuf[txTail];
+txTail = (txTail + 1) & TXMASK;
+}
+else
+{
+PIE1bits.TX1IE = FALSE; //ring drained
+}
+}// eo txISR::
+ 
+/*>>> adcISR: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		Each ADC complete interrupt stores the result in the filling window of
+that ring, swaps windows once fastLen samples are in and starts the 
+next owed channel. The first sample above rawTrip is time stamped as 
+the stimulus. The tick shares scanPos and the rings, so it is held off
+for the few instructions this takes.
+Input: 		None
+Returns:	None
+============================================================================*/
+void adcISR(void)
+{
+ADCFLAG = FALSE;
+INTCONbits.GIEH = FALSE;
+if(scanPos < SENCOUNT)
+{
+volatile adcRing_t *ring = &adcRings[scanPos];
+sensor_t sample = ADRES;
+ring->sampling = FALSE;
+ring->win[ring->fill][ring->count] = sample;
+ring->count++;
+if(sample >= chanTable[scanPos].rawTrip)
+{
+ring->hot = TRUE;
+if(!ring->stimulus)
+{
+ring->stimulus = TRUE;
+ring->stimTick = tickCount;
+}
+}
+if(ring->count >= chanTable[scanPos].fastLen)
+{
+if(ring->ready)
+{
+ring->overrun++;
+}
+if(!ring->hot) //a whole window below the trip count re-arms the stimulus
+{
+ring->stimulus = FALSE;
+}
+ring->hot = FALSE;
+ring->count = 0;
+ring->fill ^= TRUE;
+ring->ready = TRUE;
+}
+scanPos++;
+startNextScan();
+}
+INTCONbits.GIEH = TRUE;
+}// eo adcISR::
+ 
+/*>>> getWindowAvg: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		This function averages the completed window of a channel's ring and
+releases it back to the ISR. This is the decimated value of the fast
+detection path. It must only be called while the ring's ready flag is set.
+Input: 		char chID, the ring whose completed window is to be read.
+Returns:	sensor_t, the average ADC count of the window.
+============================================================================*/
+sensor_t getWindowAvg(char chID)
+{
+volatile adcRing_t *ring = &adcRings[chID];
+volatile sensor_t *win = ring->win[ring->fill ^ TRUE];
+char length = chanTable[chID].fastLen;
+long sum = 0;
+char index = 0;
+for (index = 0; index < length; index++)
+{
+sum += win[index];
+}
+ring->ready = FALSE;
+return sum / length;
+}// eo getWindowAvg::
+ 
+/*>>> recordLatency: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		This function is called when a channel raises the alarm. It stores
+the time from that channel's stimulus sample to now and keeps the worst
+case against LATENCYTARGET.
+Input: 		char chID, the channel that raised the alarm.
+Returns:	None
+============================================================================*/
+void recordLatency(char chID)
+{
+if(!adcRings[chID].stimulus)
+{
+return;
+}
+alarmLatency[chID] = (getTicks() - adcRings[chID].stimTick) * TICKMS;
+if(alarmLatency[chID] > latencyMax)
+{
+latencyMax = alarmLatency[chID];
+}
+latencyOk = latencyMax <= LATENCYTARGET;
+}// eo recordLatency::
+ 
+/*>>> convertFixed: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		This function converts an averaged ADC count into the physical value
+of the channel (ppm for smoke, meters for flame) using the Q-format 
+coefficients, so no floating point code runs in the sampling loop.
+Input: 		char chID, the channel whose coefficients are to be used.
+sensor_t avg, the averaged ADC count of that channel.
+Returns:	sensor_t, the physical value of the channel.
+============================================================================*/
+sensor_t convertFixed(char chID, sensor_t avg)
+{
+return (sensor_t)(((long)avg * chanTable[chID].scale + chanTable[chID].offset) >> QSHIFT);
+}// eo convertFixed::
+ 
+#ifdef CONVBENCH
+/*>>> convertFloat: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		Reference float conversion kept for comparing against convertFixed.
+Input: 		char chID, the channel to be converted.
+sensor_t avg, the averaged ADC count of that channel.
+Returns:	sensor_t, the physical value of the channel.
+============================================================================*/
+sensor_t convertFloat(char chID, sensor_t avg)
+{
+float volts = avg * ADCRES;
+switch (chID)
+{
+case SMOKE:
+//smoke sensor linear equation C = 1940*V+300( for range 300-10000 ppm)
+return (float)volts*SMOKEB+SMOKEM;
+ 
+case FLAME:
+//D=6*V(for range 0-30 meter)
+return (float)volts*FLAMEM;
+ 
+default:
+return avg;
+}
+}// eo convertFloat::
+ 
+/*>>> benchConvert: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		This function times both conversion paths on the same average with
+Timer1 and stores the cycle counts in convCycles[].
+Input: 		char chID, the channel to be converted.
+sensor_t avg, the averaged ADC count of that channel.
+Returns:	None
+============================================================================*/
+void benchConvert(char chID, sensor_t avg)
+{
+unsigned int start = 0;
+start = readTMR1();
+convertFixed(chID, avg);
+convCycles[0] = readTMR1() - start;
+start = readTMR1();
+convertFloat(chID, avg);
+convCycles[1] = readTMR1() - start;
+}// eo benchConvert::
+#endif
+ 
+/*>>> queueTX: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		This function copies a frame into the transmit ring and enables the
+transmitter interrupt that sends it. A frame that does not fit is 
+dropped whole and counted in txDrops, so the caller never waits.
+Input: 		unsigned char *data, the frame to be sent.
+char len, the number of bytes in the frame.
+Returns:	char, TRUE if the frame was queued.
+============================================================================*/
+char queueTX(unsigned char *data, char len)
+{
+char head = txHead;
+if(((txTail - head - 1) & TXMASK) < len) //free slots in the ring
+{
+txDrops++;
+return FALSE;
+}
+for (; len > 0; len--)
+{
+txBuf[head] = *data++;
+head = (head + 1) & TXMASK;
+}
+txHead = head;
+PIE1bits.TX1IE = TRUE;
+return TRUE;
+}// eo queueTX::
+ 
+/*>>> crc16: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		This function computes the CRC-16/CCITT of a block of bytes with 
+crc16Update, the step the receiver uses too.
+Input: 		unsigned char *data, the bytes to be covered.
+char len, the number of bytes.
+Returns:	unsigned int, the CRC of the block.
+============================================================================*/
+unsigned int crc16(unsigned char *data, char len)
+{
+unsigned int crc = CRCINIT;
+for (; len > 0; len--)
+{
+crc = crc16Update(crc, *data++);
+}
+return crc;
+}// eo crc16::
  
 /*>>> transmitSen: ===========================================================
 Author:	Vaibhav Sinha
 Date:		11/06/2024
 Modified:	None
-Desc:		This function will use the serial communication to transmit a string.
-Input: 		None
+Desc:		This function will use the serial communication to transmit a frame:
+sync, node id, type, payload length, payload and the CRC-16 of the node
+id to payload bytes, high byte first. Every payload starts with a 
+sequence number so the receiver can spot a lost frame. Values are sent
+high byte first.
+FRM_ALM: seq, ch, det (DET_LEVEL or DET_RATE), fast value of ch.
+FRM_CLR: seq, ch, fast value of ch.
+FRM_SEN: seq, duty, chanCyclesMax, loopCyclesMax, slow value of every
+channel; sent every REPORTTICKS ticks it also tells the receiver the
+node is alive.
+Input: 		char type, FRM_ALM, FRM_CLR or FRM_SEN.
+char chID, the channel whose alarm changed.
+char det, the detector that raised the alarm.
+Returns:	None
+============================================================================*/
+void transmitSen(char type, char chID, char det)
+{
+unsigned char frame[FRMHEAD + SENLEN(SENCOUNT) + FRMCRC];
+char len = FRMHEAD;
+unsigned int crc = 0;
+txSeq++;
+frame[0] = FRMSYNC;
+frame[1] = FIRENODE;
+frame[2] = type;
+frame[len++] = txSeq;
+switch (type)
+{
+case FRM_ALM:
+frame[len++] = chID;
+frame[len++] = det;
+frame[len++] = sensors[chID].fast >> BYTESIZE;
+frame[len++] = sensors[chID].fast;
+break;
+ 
+case FRM_CLR:
+frame[len++] = chID;
+frame[len++] = sensors[chID].fast >> BYTESIZE;
+frame[len++] = sensors[chID].fast;
+break;
+ 
+default:
+frame[len++] = dutyCycle;
+frame[len++] = chanCyclesMax >> BYTESIZE;
+frame[len++] = chanCyclesMax;
+frame[len++] = loopCyclesMax >> BYTESIZE;
+frame[len++] = loopCyclesMax;
+for (chID = 0; chID < SENCOUNT; chID++)
+{
+frame[len++] = sensors[chID].avg >> BYTESIZE;
+frame[len++] = sensors[chID].avg;
+}
+break;
+}
+frame[3] = len - FRMHEAD;
+crc = crc16(frame + 1, len - 1);
+frame[len++] = crc >> BYTESIZE;
+frame[len++] = crc;
+queueTX(frame, len);
+}// eo transmitSen::
+ 
+/*>>> countPersist: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		This function counts the windows among the last persistM that met
+the pending transition of a channel.
+Input: 		unsigned char persist, the window history, newest in bit 0.
+char persistM, the number of windows to look at.
+Returns:	char, the number of windows that met the transition.
+============================================================================*/
+char countPersist(unsigned char persist, char persistM)
+{
+char count = 0;
+for (; persistM > 0; persistM--)
+{
+count += persist & TRUE;
+persist >>= 1;
+}
+return count;
+}// eo countPersist::
+ 
+/*>>> setAlarmOutputs: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		This function drives the flag pin of a channel whose alarm has just 
+been raised or cleared, and switches ALARM and MOTOR only when the first
+channel raises or the last one clears.
+Input: 		char chID, the channel whose alarm changed.
+char raised, TRUE if the alarm was raised.
 Returns:	None
 ============================================================================*/
-void transmitSen()
+void setAlarmOutputs(char chID, char raised)
 {
-char receivingBuf[] = {"$ALM\r"};
-puts1USART(receivingBuf);	
-}// eo getADCSample::
+const rom chanDesc_t *desc = &chanTable[chID];
+if (raised)
+{
+*desc -> flagLat |= desc -> flagMask;
+activeCount++;
+}
+else
+{
+*desc -> flagLat &= ~desc -> flagMask;
+activeCount--;
+}
+if (activeCount == (raised ? 1 : 0))
+{
+ALARM = raised;
+MOTOR = raised;
+}
+}// eo setAlarmOutputs::
+ 
+/*>>> evaluateCh: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		This function runs the alarm state machine of a channel whose fast 
+value has just been updated. A window is over when the level passes 
+duckLimit or the rate detector fires, and under when the level is 
+hyst below duckLimit with no rate alarm.
+NORMAL -> PREALARM on an over window.
+PREALARM -> ALARM once raiseN of the last persistM windows are over,
+back to NORMAL once none of them are.
+ALARM -> CLEARING on an under window.
+CLEARING -> NORMAL once clearN of the last persistM windows are under,
+back to ALARM on an over window.
+Outputs and frames only change on entering ALARM from PREALARM and
+NORMAL from CLEARING, so the motor and the link do not chatter.
+Input: 		char chID, the channel to be evaluated.
+char rising, TRUE while the channel's rate alarm is held.
+Returns:	None
+============================================================================*/
+void evaluateCh(char chID, char rising)
+{
+sensorCh_t *sen = &sensors[chID];
+const rom chanDesc_t *desc = &chanTable[chID];
+char level = sen -> fast > sen -> duckLimit;
+char over = level || rising;
+char under = !rising && sen -> fast < sen -> duckLimit - desc -> hyst;
+switch (sen -> state)
+{
+case ST_NORMAL:
+if (!over)
+{
+break;
+}
+sen -> state = ST_PREALARM;
+sen -> persist = FALSE;
+//counting this window as well
+case ST_PREALARM:
+sen -> persist = (sen -> persist << 1) | over;
+if (countPersist(sen -> persist, desc -> persistM) >= desc -> raiseN)
+{
+sen -> state = ST_ALARM;
+setAlarmOutputs(chID, TRUE);
+recordLatency(chID);
+transmitSen(FRM_ALM, chID, level ? DET_LEVEL : DET_RATE);
+}
+else if (!countPersist(sen -> persist, desc -> persistM))
+{
+sen -> state = ST_NORMAL;
+}
+break;
+ 
+case ST_ALARM:
+if (!under)
+{
+break;
+}
+sen -> state = ST_CLEARING;
+sen -> persist = FALSE;
+//counting this window as well
+case ST_CLEARING:
+sen -> persist = (sen -> persist << 1) | under;
+if (countPersist(sen -> persist, desc -> persistM) >= desc -> clearN)
+{
+sen -> state = ST_NORMAL;
+setAlarmOutputs(chID, FALSE);
+transmitSen(FRM_CLR, chID, FALSE);
+}
+else if (over)
+{
+sen -> state = ST_ALARM;
+}
+break;
+ 
+default:
+sen -> state = ST_NORMAL;
+break;
+}
+}// eo evaluateCh::
  
 /*>>> systemInit: ===========================================================
 Author:	Vaibhav Sinha
@@ -270,7 +1027,9 @@ setOSC4MHz(); //setting the oscillation frequency
 configPorts(); //configuring the I/O ports	
 configADC(); //setting the ADC Module
 configUSART(); //setting the serial communication
-configTMR0(HUNDREDMILSEC); //setting the Timer Module for 100ms
+configTMR2(); //setting the Timer Module for the 10ms tick
+configINTS(); //timer driven ADC scan
+configPwrMgmt(TICKCYCLES, DUTYTICKS); //Timer1 cycle counts, idling between interrupts
 }// eo systemInit::
  
  
@@ -279,100 +1038,79 @@ configTMR0(HUNDREDMILSEC); //setting the Timer Module for 100ms
  
 void main( void )
 {
-char secCount = 0;
 char count = 0;
-long sum = 0;
-char index = 0;
-float volts = 0;
  
 systemInit(); //initializing the system
  
 for (count = 0; count < SENCOUNT; count++)
 {
-initSensorCh(&sensors[count]);
+initSensorCh(&sensors[count], &chanTable[count]);
 }
  
 while(1)
 {
-if (T0FLAG == TRUE)//100mS Rollover
-{
-resetTMR0(HUNDREDMILSEC);//reseting after rollover
-secCount++;
-if (secCount >= ONESEC)//timer rolled over 10 times (1 second)
-{
 char chID = 0;
-secCount = 0;
-//collecting samples 2 different channels
-//and storing them into sample arrays.
+char worked = 0; //channels evaluated this pass
+unsigned int start = readTMR1();
+//taking the completed fast window of each channel
 for (chID = 0; chID < SENCOUNT; chID++)
 {
-sensors[chID].sample[sensors[chID].insert] = getADCSample(chID);
-sensors[chID].insert++;
-if (sensors[chID].insert > SAMPLESIZE)
+sensor_t raw = 0;
+if (!adcRings[chID].ready)
 {
-sensors[chID].insert = FALSE;
-sensors[chID].avgReady = TRUE;
-} 
-//collecting 10 samples for each channel and taking their average
-if(sensors[chID].avgReady)
+continue;
+}
+worked++;
+raw = getWindowAvg(chID);
+//fast detection path, converted every window
+sensors[chID].fast = convertFixed(chID, raw);
+//slow reporting path, decimating the fast windows into the channel history
+sensors[chID].slowSum += raw;
+sensors[chID].slowCount++;
+if(sensors[chID].slowCount >= chanTable[chID].slowLen)
 {
-long sum = 0;
-for(index = 0; index < SAMPLESIZE; index++)
+sensors[chID].slowRaw = filterSample(&sensors[chID], sensors[chID].slowSum / chanTable[chID].slowLen);
+sensors[chID].slowSum = 0;
+sensors[chID].slowCount = 0;
+#ifdef CONVBENCH
+if(sensors[chID].avgReady)
 {
-            	sum += sensors[chID].sample[index];
+benchConvert(chID, sensors[chID].slowRaw);
 }
-sensors[chID].avg = sum / SAMPLESIZE;
-volts = sensors[chID].avg * ADCRES;
-//calculating the physical value using the linear eqations of each sensor
-switch (chID)
-{
-case SMOKE:
-//smoke sensor linear equation C = 1940*V+300( for range 300-10000 ppm)
-volts = volts*SMOKEB; 
-sensors[chID].avg = (float)volts+SMOKEM;
-break;
-
-case FLAME:
-//D=6*V(for range 0-30 meter)
-sensors[chID].avg = (float)volts*FLAMEM; 
-break;
-
-default:
-break;
+#endif
+//calculating the physical value using the linear eqations of each sensor,
+//from the first filtered value on so FRM_SEN never carries ADC counts
+sensors[chID].avg = convertFixed(chID, sensors[chID].slowRaw);
 }
 //taking action based on differnt scenarios
-if (sensors[SMOKE].avg > sensors[SMOKE].duckLimit)
+evaluateCh(chID, checkRise(&sensors[chID]));
+}//for channel switching
+//cost of a pass grows with the number of channels that completed a window,
+//so the cost of one channel tells what a larger SENCOUNT would take
+if (worked)
 {
-ALARM = TRUE;
-MOTOR = TRUE;
-SMOKE_FLAG = TRUE;
-transmitSen();		
-}
-else
+loopCycles = readTMR1() - start;
+chanCycles = loopCycles / worked;
+if (loopCycles > loopCyclesMax)
 {
-SMOKE_FLAG = FALSE;
+loopCyclesMax = loopCycles;
 }
-if (sensors[FLAME].avg > sensors[FLAME].duckLimit)
+if (chanCycles > chanCyclesMax)
 {
-ALARM = TRUE;
-MOTOR = TRUE;
-FLAME_FLAG = TRUE;
-transmitSen();	
+chanCyclesMax = chanCycles;
 }
-else
+}
+//reporting the sensor values, which also keeps the link alive
+updateDuty();
+if (getTicks() - lastTxTick >= REPORTTICKS)
 {
-FLAME_FLAG = FALSE;
+lastTxTick += REPORTTICKS;
+transmitSen(FRM_SEN, 0, FALSE);
 }
-if(sensors[SMOKE].avg < sensors[SMOKE].duckLimit  && sensors[FLAME].avg < sensors[FLAME].duckLimit)
+//nothing left to do until the next tick, ADC result or transmit slot
+if (!worked)
 {
-ALARM = FALSE;
-MOTOR = FALSE;
-SMOKE_FLAG = FALSE;	
-FLAME_FLAG = FALSE;		
+idleUntilWake();
 }
-}//if average ready
-}//for channel switching			
-}//eo if seccount reaches 10								
-}//eo if T0FLAG
 }//eo while loop::
 } // eo main::
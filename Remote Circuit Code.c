@@ -35,6 +35,9 @@
 #include <delays.h>
 #include "xlcd.h"
 #include <string.h>
+#include "nodePower.h"
+#include "nodeIsr.h"
+#include "panelLcd.h"
 
 // Constants  -----------------------------------------------------------------
 #define TRUE 1
@@ -83,13 +86,114 @@
 #define MASTERON_OFF LATCbits.LATC3
 #define MASTERLOCK_IN PORTCbits.RC7
 #define MAINTENANCEMODE_LED LATAbits.LATA3
+#define T2FLAG PIR1bits.TMR2IF
+#define IOCFLAG INTCONbits.RBIF		// RB4 to RB7 interrupt on change
+#define T2TENMILSEC 0x4E		// Timer2 on, 1:16 prescale, 1:10 postscale
+#define PR2TENMILSEC 249		// 10ms tick with T2TENMILSEC at 16MHz
+#define ALARMIOC 0x30			// RB4 smoke and RB5 flame alarm inputs
+#define SMOKEBIT 0x10			// RB4 in alarmInputs
+#define FLAMEBIT 0x20			// RB5 in alarmInputs
+#define INTGON 0xC0			// GIEH and GIEL
+#define TMR2MASK 0x02			// TMR2IF in PIR1, TMR2IE in PIE1
+#define RBMASKF 0x01			// RBIF in INTCON
+#define RBMASKE 0x08			// RBIE in INTCON
+#define DUTYTICKS 100			// ticks per duty cycle figure (1s)
+#define TICKCYCLES 40000		// instruction cycles per tick at 16MHz
+#define MSGHOLD 150			// ticks a message stays up (1.5s)
+#define PATLED 0x80			// pattern step lights ALARMLED
+#define PATBUZZ 0x40			// pattern step sounds ALARMBUZZER unless silenced
+#define PATBOTH (PATLED | PATBUZZ)
+#define PATTICKS 0x3F			// ticks the step lasts, a 0 step ends the pattern
+#define ALM_FLAME 0			// alarm classes, highest priority first
+#define ALM_SMOKE 1
+#define ALM_TEMP 2
+#define ALMCOUNT 3
+#define ALMNONE ALMCOUNT		// no alarm is being annunciated
+#define LATLINE 24			// longest alarm latency line
+#define PB_STATUS 0			// bits of the pushbuttons in keyState
+#define PB_RST 1
+#define PB_UNLOCK 2
+#define PB_REMOX 3
+#define PB_DISPLAY 4
+#define PBCOUNT 5
+#define KEYDOWN(pb) (keyState & (1 << (pb)))	// debounced pushbutton is pressed
+#define KEY_PRESS 0x10			// key events, or'ed with the pushbutton
+#define KEY_RELEASE 0x20
+#define KEY_LONG 0x30
+#define LONGTICKS 100			// ticks held for a long press (1s)
+#define KEYQSIZE 16			// key event queue size, a power of 2
+#define KEYQMASK (KEYQSIZE - 1)
+#define STATUSHOLD 60			// ticks each sensor status stays up (600ms)
 // Global Variables  ----------------------------------------------------------
 
 	char passFlag = FALSE;
 	char smokeFlag = FALSE;
 	char flameFlag = FALSE;
 	char tempFlag = FALSE;
-	char alarmRST = FALSE;
+	volatile char alarmRST = FALSE;		// TRUE while the buzzer is silenced
+	volatile char alarmInputs = FALSE;	// RB4 and RB5 at the last change
+	const rom unsigned char *patStep = NULL;	// step of the pattern being played
+	volatile unsigned char patLeft = FALSE;	// ticks left in the step
+	volatile char patPlaying = FALSE;	// TRUE until the pattern has played once
+	unsigned char alarmSet = FALSE;		// active alarms, one bit per class
+	unsigned char alarmWaiting = FALSE;	// raised alarms not annunciated yet
+	char alarmNow = ALMNONE;		// class on the display and buzzer
+	volatile unsigned int alarmRaised[ALMCOUNT];	// tick each class was last raised
+	volatile unsigned char alarmStamped = FALSE;	// classes alarmISR stamped since sampleAlarms looked
+	unsigned char alarmDrawing = FALSE;	// annunciated alarms whose text lcdISR is still sending
+	unsigned int alarmLat[ALMCOUNT];	// ticks from raising to the text being on the LCD, last
+	unsigned int alarmLatMax[ALMCOUNT];	// and longest, of each class
+	volatile unsigned char keyState = FALSE;	// debounced pushbuttons, 1 while pressed
+	unsigned char keyCnt0 = FALSE;		// vertical counter of samples differing from
+	unsigned char keyCnt1 = FALSE;		// keyState, bit 0 and bit 1 of each pushbutton
+	unsigned char keyHeld[PBCOUNT];		// ticks each pushbutton has been held
+	unsigned char keyFifo[KEYQSIZE];	// key events, filled by tickISR only
+	unsigned int keyStamp[KEYQSIZE];	// tick each key event was queued
+	volatile unsigned char keyHead = FALSE;	// next free slot, written by tickISR only
+	volatile unsigned char keyTail = FALSE;	// next event to read, written by main only
+	unsigned int keyDrops = FALSE;		// key events lost to a full queue
+	unsigned int keyLatency = FALSE;	// ticks the last key event waited to be acted on
+	unsigned int keyLatMax = FALSE;		// longest wait of a key event
+
+// Alarm patterns, one byte per step: PATLED and PATBUZZ with the ticks the 
+// step lasts, ended by a 0 step. Each plays once per turn of its alarm.
+const rom unsigned char tempPattern[] = 
+{
+	PATBOTH | 10, 25, PATBOTH | 10, 1, PATBOTH | 25, 20, 0
+};
+const rom unsigned char flamePattern[] = 
+{
+	PATBOTH | 25, 10, PATBOTH | 25, 1, PATBOTH | 25, 20, 0
+};
+const rom unsigned char smokePattern[] = 
+{
+	PATBOTH | 25, 10, PATBOTH | 25, 10, PATBOTH | 25, 20, 0
+};
+
+// Prototypes
+void tickISR(void);
+void playStep(void);
+void debounceKeys(void);
+void sampleAlarms(void);
+void timeAlarms(void);
+void alarmISR(void);
+
+// Interrupt sources ----------------------------------------------------------
+// Dispatched by nodeIsr.c, each table ends with a NULL handler.
+// alarm inputs and timebase on the high vector
+const rom isrSource_t highTable[] =
+{
+	{&INTCON, RBMASKF, &INTCON, RBMASKE, alarmISR},
+	{&PIR1, TMR2MASK, &PIE1, TMR2MASK, tickISR},
+	{NULL, 0, NULL, 0, NULL}
+};
+
+// LCD transfers on the low vector
+const rom isrSource_t lowTable[] =
+{
+	{&PIR5, TMR6MASK, &PIE5, TMR6MASK, lcdISR},
+	{NULL, 0, NULL, 0, NULL}
+};
 /*>>> setOsc: ===========================================================
 Author:	Shubham
 Date:		06/07/2024
@@ -103,6 +207,277 @@ void setOsc()
 	OSCCON = 0x72; 	    //configures 16MHz operation 
 	while(!OSCCONbits.HFIOFS);
 } // eo setOsc::
+/*>>> configTMR2: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		It Configures Timer2 for the 10ms tick that wakes the panel
+Input: 		None
+Returns:	None
+============================================================================*/
+void configTMR2(void)
+{
+	TMR2 = FALSE;
+	PR2 = PR2TENMILSEC;
+	T2CON = T2TENMILSEC;
+}//configTMR2::
+/*>>> configINTS: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		It enables the Timer2 tick and the interrupt on change of the smoke and
+			flame alarm inputs, so either one wakes the panel from IDLE. Both are
+			high priority. The LCD transfer timer is low priority and only enabled
+			while transfers are queued
+Input: 		None
+Returns:	None
+============================================================================*/
+void configINTS(void)
+{
+	T2FLAG = FALSE;
+	IPR1bits.TMR2IP = TRUE;
+	PIE1bits.TMR2IE = TRUE;
+	IOCB = ALARMIOC;
+	alarmInputs = PORTB & ALARMIOC;	// reading PORTB ends any mismatch
+	IOCFLAG = FALSE;
+	INTCON2bits.RBIP = TRUE;
+	INTCONbits.RBIE = TRUE;
+	T6FLAG = FALSE;
+	IPR5bits.TMR6IP = FALSE;
+	RCONbits.IPEN = TRUE;		// Global interrupt priority enabled
+	INTCON |= INTGON;		// Enable high and low priority interrupts
+}//configINTS::
+/*>>> tickISR: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		It counts the Timer2 ticks, plays the alarm pattern and samples the 
+			pushbuttons
+Input: 		None
+Returns:	None
+============================================================================*/
+void tickISR(void)
+{
+	T2FLAG = FALSE;
+	tickCount++;
+	playStep();
+	debounceKeys();
+}//tickISR::
+/*>>> alarmISR: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		It acknowledges the alarm input changes, which wake the panel, and 
+			stamps a flame or smoke alarm with the tick of its rising edge, so 
+			its latency is counted from the input and not from the next sample
+Input: 		None
+Returns:	None
+============================================================================*/
+void alarmISR(void)
+{
+	unsigned char inputs = PORTB & ALARMIOC;	// ending the mismatch before clearing the flag
+	unsigned char rising = inputs & ~alarmInputs;
+	IOCFLAG = FALSE;
+	if(rising & FLAMEBIT)
+	{
+		alarmRaised[ALM_FLAME] = tickCount;
+		alarmStamped |= 1 << ALM_FLAME;
+	}
+	if(rising & SMOKEBIT)
+	{
+		alarmRaised[ALM_SMOKE] = tickCount;
+		alarmStamped |= 1 << ALM_SMOKE;
+	}
+	alarmInputs = inputs;
+}//alarmISR::
+/*>>> patOutputs: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		It drives ALARMLED and ALARMBUZZER for the current pattern step, leaving 
+			the buzzer off while it is silenced
+Input: 		None
+Returns:	None
+============================================================================*/
+void patOutputs(void)
+{
+	ALARMLED = (*patStep & PATLED) ? TRUE : FALSE;
+	ALARMBUZZER = ((*patStep & PATBUZZ) && !alarmRST) ? TRUE : FALSE;
+}//patOutputs::
+/*>>> queueKey: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		It queues a key event with its tick for the main loop, counting it in 
+			keyDrops if the queue is full
+Input: 		unsigned char event, KEY_PRESS, KEY_RELEASE or KEY_LONG or'ed with the
+			pushbutton
+Returns:	None
+============================================================================*/
+void queueKey(unsigned char event)
+{
+	unsigned char next = (keyHead + TRUE) & KEYQMASK;
+	if(next == keyTail)
+	{
+		keyDrops++;
+		return;
+	}
+	keyFifo[keyHead] = event;
+	keyStamp[keyHead] = tickCount;
+	keyHead = next;
+}//queueKey::
+/*>>> debounceKeys: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		Called by tickISR every 10ms, it samples all the pushbuttons at once. A
+			two bit vertical counter per pushbutton counts the samples in a row 
+			that differ from keyState, and a pushbutton only changes in keyState 
+			after 4 of them (30 to 40ms), so bounces and glitches are ignored. 
+			Each change queues a press or release, and holding a pushbutton for 
+			LONGTICKS queues a long press
+Input: 		None
+Returns:	None
+============================================================================*/
+void debounceKeys(void)
+{
+	unsigned char raw = FALSE;
+	unsigned char delta = FALSE;
+	unsigned char changed = FALSE;
+	char pb = FALSE;
+	if(!STATUSPB)			// the pushbuttons pull low when pressed
+	{
+		raw |= 1 << PB_STATUS;
+	}
+	if(!ALARM_RST_PB)
+	{
+		raw |= 1 << PB_RST;
+	}
+	if(!UNLOCKPB)
+	{
+		raw |= 1 << PB_UNLOCK;
+	}
+	if(!REMOXIN)
+	{
+		raw |= 1 << PB_REMOX;
+	}
+	if(!DISPLAYON)
+	{
+		raw |= 1 << PB_DISPLAY;
+	}
+	delta = raw ^ keyState;
+	keyCnt1 = (keyCnt1 ^ keyCnt0) & delta;	// counting where the sample differs,
+	keyCnt0 = ~keyCnt0 & delta;		// clearing the count where it agrees
+	changed = delta & ~(keyCnt0 | keyCnt1);	// counts that wrapped round
+	keyState ^= changed;
+	for(pb = 0; pb < PBCOUNT; pb++)
+	{
+		if(changed & (1 << pb))
+		{
+			queueKey((KEYDOWN(pb) ? KEY_PRESS : KEY_RELEASE) | pb);
+			keyHeld[pb] = FALSE;
+		}
+		else if(KEYDOWN(pb) && keyHeld[pb] < LONGTICKS)
+		{
+			keyHeld[pb]++;
+			if(keyHeld[pb] == LONGTICKS)
+			{
+				queueKey(KEY_LONG | pb);
+			}
+		}
+	}
+}//debounceKeys::
+/*>>> playStep: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		Called by tickISR, it moves the pattern on to its next step once the 
+			ticks of the current one have passed and switches the outputs off at
+			the end of the pattern. The outputs are refreshed on every tick, so
+			silencing the buzzer takes effect within a tick
+Input: 		None
+Returns:	None
+============================================================================*/
+void playStep(void)
+{
+	if(!patPlaying)
+	{
+		return;
+	}
+	patLeft--;
+	if(!patLeft)
+	{
+		patStep++;
+		patLeft = *patStep & PATTICKS;
+		if(!patLeft)	// end of the pattern
+		{
+			patPlaying = FALSE;
+			ALARMLED = FALSE;
+			ALARMBUZZER = FALSE;
+			return;
+		}
+	}
+	patOutputs();
+}//playStep::
+/*>>> playPattern: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		It starts playing a pattern from its first step; tickISR plays the rest
+Input: 		const rom unsigned char *pattern, the pattern to play
+Returns:	None
+============================================================================*/
+void playPattern(const rom unsigned char *pattern)
+{
+	INTCONbits.GIEH = FALSE;	// tickISR plays the same pattern
+	patStep = pattern;
+	patLeft = *patStep & PATTICKS;
+	patPlaying = TRUE;
+	patOutputs();
+	INTCONbits.GIEH = TRUE;
+}//playPattern::
+/*>>> stopPattern: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		It stops the pattern being played and switches the outputs off
+Input: 		None
+Returns:	None
+============================================================================*/
+void stopPattern(void)
+{
+	INTCONbits.GIEH = FALSE;
+	patPlaying = FALSE;
+	ALARMLED = FALSE;
+	ALARMBUZZER = FALSE;
+	INTCONbits.GIEH = TRUE;
+}//stopPattern::
+/*>>> readKey: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		It takes the oldest key event out of the queue and keeps the ticks it 
+			waited to be acted on in keyLatency, the longest in keyLatMax. The 
+			debounce adds 30 to 40ms before an event is queued
+Input: 		None
+Returns:	unsigned char, the key event, or FALSE if there is none
+============================================================================*/
+unsigned char readKey(void)
+{
+	unsigned char event = FALSE;
+	if(keyTail == keyHead)
+	{
+		return FALSE;
+	}
+	event = keyFifo[keyTail];
+	keyLatency = getTicks() - keyStamp[keyTail];
+	if(keyLatency > keyLatMax)
+	{
+		keyLatMax = keyLatency;
+	}
+	keyTail = (keyTail + TRUE) & KEYQMASK;
+	return event;
+}//readKey::
 /*>>> DelayFor18TCY: ===========================================================
 Author:	Shubham
 Date:		06/07/2024
@@ -161,6 +536,37 @@ void DelayXLCD (void)
  Delay1KTCYx(DELAYCOUNT_2); 
  return;
 }//DelayXLCD::
+/*>>> holdDisplay: ===========================================================
+Author:		
+Date:		
+Modified:	None
+Desc:		It keeps the screen as it is for a number of ticks, idling in between.
+			The hold starts once lcdISR has sent the queued text, and is cut 
+			short by a newly raised alarm unless remote access is on; the 
+			caller then drops the rest of its screens so the alarm is drawn
+Input: 		unsigned int ticks, the 10ms ticks to wait
+Returns:	char, TRUE if an alarm cut the hold short
+============================================================================*/
+char holdDisplay(unsigned int ticks)
+{
+	unsigned int start = FALSE;
+	while(!lcdDone)		// still rendering
+	{
+		idleUntilWake();
+	}
+	start = getTicks();
+	while(getTicks() - start < ticks)
+	{
+		sampleAlarms();
+		timeAlarms();
+		if(alarmWaiting && !REMOXOUT)	// the alarm takes the display
+		{
+			return TRUE;
+		}
+		idleUntilWake();
+	}
+	return FALSE;
+}//holdDisplay::
 
 /*>>> userMode: ===========================================================
 Author:	Shubham
@@ -172,64 +578,35 @@ Returns:	None
 ============================================================================*/
 void userMode(char *ptr1,char *ptr2)//DISPLAY INTRUDER ALERT
 {
-	SetDDRamAddr(0x82);			// Sets the cursor in first line 
-	Delay10KTCYx(40);
-	while(*ptr1 != '\0')// while loop to print the data
-	{
-		WriteDataXLCD(*ptr1);
-		ptr1++;
-		Delay10KTCYx(50);
-	}//eo while
-	Delay10KTCYx(20);
-	SetDDRamAddr(0x41);			// This sets the cursor in second line									
-	Delay10KTCYx(50);
-	while(*ptr2 != '\0')
-	{
-		WriteDataXLCD(*ptr2);
-		ptr2++;
-		Delay10KTCYx(50);
-	}//eo while
-	while(BusyXLCD());//continue until the LCD is busy
-	WriteCmdXLCD(0x01);             // Clear display
-	Delay10KTCYx(20);
+	lcdClear();
+	lcdPuts(0x82, ptr1);			// first line 
+	lcdPuts(0x41, ptr2);			// second line
+	lcdFlush();
+	if(!holdDisplay(MSGHOLD))
+	{
+		lcdClear();
+		lcdFlush();
+	}
 	CONTROLLED = TRUE;//turning on the control On led
 }//userMode::
 /*>>> introMessage: ===========================================================
 Author:	Shubham
 Date:		24/07/2024
 Modified:	NoNe 
-Desc:		This function displays the the introduction message in first and second line
+Desc:		This function displays the the introduction message in first and second line.
+			It is the idle screen and stays up until something else is drawn, so
+			drawing it again sends nothing to the LCD
 Input:		char *ptr1 and char *ptr2 to the arrays having Introduction message
 Returns:	None
 ============================================================================*/
 void introMessage(char *ptr1,char *ptr2)
 {
-	SetDDRamAddr(0x81);			// This function is used to keep or set the 
-									// cursor at particular location.
-	Delay10KTCYx(4);
-//	Delay10KTCYx(20);
-	while(*ptr1 != '\0')
-	{
-		WriteDataXLCD(*ptr1);
-		ptr1++;
-		Delay10KTCYx(50);
-		flameFlag = FLAMEALARM;
-		smokeFlag = SMOKEALARM;
-	}
-	Delay10KTCYx(5);
-	SetDDRamAddr(0x42);			// This function is used to keep or set the 									// cursor at particular location.
-	Delay10KTCYx(5);
-	while(*ptr2 != '\0')
-	{
-		WriteDataXLCD(*ptr2);
-		ptr2++;
-		Delay10KTCYx(50);
-		flameFlag = FLAMEALARM;
-		smokeFlag = SMOKEALARM;
-	}
-	while(BusyXLCD());
-	WriteCmdXLCD(0x01);             // Clear display
-	Delay10KTCYx(2);
+	lcdClear();
+	lcdPuts(0x81, ptr1);
+	lcdPuts(0x42, ptr2);
+	lcdFlush();
+	flameFlag = FLAMEALARM;
+	smokeFlag = SMOKEALARM;
 }//introMessage::
 
 /*>>> fillPass: ===========================================================
@@ -243,228 +620,232 @@ Returns:	None
 ============================================================================*/
 void fillPass(char *ptr)// Display PASSWORD ENTERING PROCESS
 {
-	SetDDRamAddr(0x45);// This function is used to keep Cursor at 2nd LINE at 5 position
-	Delay1KTCYx(TRUE);
-	while(*ptr != '\0')
-	{
-		WriteDataXLCD(*ptr);
-		ptr++;
-		Delay10KTCYx(20);
-	}//eo while
-	while(BusyXLCD());
-	
+	lcdPuts(0x45, ptr);// 2nd LINE at 5 position
+	lcdFlush();
 }//fillPass::
-/*>>> almRST: ===========================================================
-Author:	Shubham
-Date:		07/08/2024
-Modified:	NoNe 
-Desc:		This function turn on/off buzzer
-Input: 		None
-Returns:	None
-============================================================================*/
-
-void almRST (void)
-{
- 	//ALARM RESET(BUZZER OFF)		
-		if(!ALARM_RST_PB&&!alarmRST)//turn off the buzzer
-		{
-			alarmRST = TRUE;
-		}//eo if
-		else if(!ALARM_RST_PB&&alarmRST)// turn on the buzzer
-		{
-			alarmRST= FALSE;	
-		}//eo else if
-		
-}//almRST::
 /*>>> tempAlarm: ===========================================================
 Author:	Shubham
 Date:		25/07/2024
 Modified:	NoNe 
-Desc:		This function displays temperature warning on LCD
-Returns:	None
+Desc:		This function displays temperature warning on LCD and starts its pattern
+Returns:	char, TRUE if the alarm is active
 ============================================================================*/
-void tempAlarm()
+char tempAlarm(void)
 {
-	char count = 0;
 	char tempAlarm[]={"!Temp Alarm!"};
-	SetDDRamAddr(0x80);	// setting cursor in first line
-	Delay1KTCYx(10);
-	if(tempFlag)
+	if(!tempFlag)
 	{
-		SYSTEMOK=FALSE;//turning off system LED
-		DISPLAYONLED= FALSE;//Turning off display LED
-		while(tempAlarm[count] != '\0')
-		{
-			WriteDataXLCD(tempAlarm[count]);
-			count++;
-			Delay10KTCYx(50);
-			flameFlag = FLAMEALARM;
-			smokeFlag = SMOKEALARM;
-			almRST();//checking buzzer status
-		}//eo while
-		while(BusyXLCD());
-// toggling the Alarm LED and Buzzer
-		ALARMLED = TRUE;
-		almRST();
-		if(!alarmRST)
-		{
-			ALARMBUZZER = TRUE;
-		}		
-		Delay10KTCYx(40);
-		ALARMLED = FALSE;
-		ALARMBUZZER = FALSE;
-		Delay10KTCYx(100);
-		almRST();
-		ALARMLED = TRUE;
-		if(!alarmRST)
-		{
-			ALARMBUZZER = TRUE;
-		}		
-		Delay10KTCYx(40);
-		ALARMLED = FALSE;
-		ALARMBUZZER = FALSE;
-		almRST();
-		ALARMLED = TRUE;
-		if(!alarmRST)
-		{
-			ALARMBUZZER = TRUE;
-		}		
-		Delay10KTCYx(100);
-		ALARMLED = FALSE;
-		ALARMBUZZER = FALSE;
-	}
-	Delay10KTCYx(20);	
-	WriteCmdXLCD(0x01);             // Clear display
-	Delay10KTCYx(2);
+		return FALSE;
+	}
+	SYSTEMOK=FALSE;//turning off system LED
+	DISPLAYONLED= FALSE;//Turning off display LED
+	lcdClear();
+	lcdPuts(0x80, tempAlarm);	// first line
+	lcdFlush();
+	playPattern(tempPattern);	// toggling the Alarm LED and Buzzer
+	return TRUE;
 }//tempAlarm::
 /*>>> flameAlarm: ===========================================================
 Author:		Shubham
 Date:		25/07/2024
 Modified:	NoNe 
-Desc:		This function displays the flame alarm warning
+Desc:		This function displays the flame alarm warning and starts its pattern
 Input:		None
-Returns:	None
+Returns:	char, TRUE if the alarm is active
 ============================================================================*/
-void flameAlarm()
+char flameAlarm(void)
 {
-	char count = 0;
 	char FlameAlarm[]={" !!Flame Alarm!!"};
-	
-	SetDDRamAddr(0x80);//sets the cursor in first line
-	Delay1KTCYx(10);
-	
-	if(flameFlag)
+	if(!flameFlag)
 	{
-		SYSTEMOK=FALSE;
-		DISPLAYONLED= FALSE;
-		while(FlameAlarm[count] != '\0')
-		{
-			WriteDataXLCD(FlameAlarm[count]);
-			count++;
-			Delay10KTCYx(50);
-			flameFlag = FLAMEALARM;//checking other alarm status
-			smokeFlag = SMOKEALARM;
-			almRST();
-		}
-		while(BusyXLCD());
-		almRST();
-//toggling alarm and Buzzer
-		ALARMLED = TRUE;
-		if(!alarmRST)
-		{
-			ALARMBUZZER = TRUE;
-		}		
-		Delay10KTCYx(100);
-		ALARMLED = FALSE;
-		ALARMBUZZER = FALSE;
-		Delay10KTCYx(40);
-		almRST();
-		ALARMLED = TRUE;
-		if(!alarmRST)
-		{
-			ALARMBUZZER = TRUE;
-		}		
-		Delay10KTCYx(100);
-		ALARMLED = FALSE;
-		ALARMBUZZER = FALSE;
-		almRST();
-		ALARMLED = TRUE;
-		if(!alarmRST)
-		{
-			ALARMBUZZER = TRUE;
-		}//eo if		
-		Delay10KTCYx(100);
-		ALARMLED = FALSE;
-		ALARMBUZZER = FALSE;
-		count = 0;
-	}//eo if
-	Delay10KTCYx(20);	
-	WriteCmdXLCD(0x01);             // Clear display
-	Delay10KTCYx(2);
+		return FALSE;
+	}
+	SYSTEMOK=FALSE;
+	DISPLAYONLED= FALSE;
+	lcdClear();
+	lcdPuts(0x80, FlameAlarm);//first line
+	lcdFlush();
+	playPattern(flamePattern);//toggling alarm and Buzzer
+	return TRUE;
 }//flameAlarm::
 /*>>> smokeAlarm: ===========================================================
 Author:		Shubham
 Date:		25/07/2024
 Modified:	NoNe 
-Desc:		This function displays Smoke warning
+Desc:		This function displays Smoke warning and starts its pattern
 Input:		None
-Returns:	None
+Returns:	char, TRUE if the alarm is active
 ============================================================================*/
-void smokeAlarm()// Display PASSWORD ENTERING PROCESS
+char smokeAlarm(void)
 {
-	char count = 0;
 	char smokeAlarm[]={" !!Smoke Alarm!!"};
-	
-	SetDDRamAddr(0x80);	
-	Delay1KTCYx(10);
-	
+	if(!smokeFlag)
+	{
+		return FALSE;
+	}
+	SYSTEMOK=FALSE;
+	DISPLAYONLED= FALSE;
+	lcdClear();
+	lcdPuts(0x80, smokeAlarm);
+	lcdFlush();
+	playPattern(smokePattern);
+	return TRUE;
+}//smokeAlarm::
+/*>>> sampleAlarms: ===========================================================
+Author:		
+Date:		
+Modified:	None
+Desc:		This function reads the alarm inputs into alarmSet. A newly raised 
+			alarm waits in alarmWaiting until it is annunciated or clears; 
+			flame and smoke keep the tick alarmISR stamped on their edge, and
+			an alarm with no edge, the temperature or one already up at reset,
+			is stamped here
+Input:		None
+Returns:	None
+============================================================================*/
+void sampleAlarms(void)
+{
+	unsigned char active = FALSE;
+	unsigned char raised = FALSE;
+	char cls = FALSE;
+	flameFlag = FLAMEALARM;
+	smokeFlag = SMOKEALARM;
+	if(flameFlag)
+	{
+		active |= 1 << ALM_FLAME;
+	}
 	if(smokeFlag)
 	{
-		SYSTEMOK=FALSE;
-		DISPLAYONLED= FALSE;
-		while(smokeAlarm[count] != '\0')
+		active |= 1 << ALM_SMOKE;
+	}
+	if(tempFlag)
+	{
+		active |= 1 << ALM_TEMP;
+	}
+	raised = active & ~alarmSet;
+	for(cls = 0; cls < ALMCOUNT; cls++)
+	{
+		if(raised & (1 << cls))
 		{
-			WriteDataXLCD(smokeAlarm[count]);
-			count++;
-			Delay10KTCYx(50);
-			almRST();
+			INTCONbits.GIEH = FALSE;	// alarmISR writes the stamps
+			if(!(alarmStamped & (1 << cls)))
+			{
+				alarmRaised[cls] = tickCount;
+			}
+			alarmStamped &= ~(1 << cls);
+			INTCONbits.GIEH = TRUE;
 		}
-		while(BusyXLCD());
-		almRST();
-		ALARMLED = TRUE;
-		if(!alarmRST)
+	}
+	alarmWaiting = (alarmWaiting | raised) & active;
+	alarmSet = active;
+}//sampleAlarms::
+/*>>> showAlarm: ===========================================================
+Author:		
+Date:		
+Modified:	None
+Desc:		This function puts an alarm on the display and buzzer, replacing the one
+			there. A newly raised alarm is marked in alarmDrawing for timeAlarms
+			to time once its text is on the LCD
+Input:		char cls, the alarm class
+Returns:	None
+============================================================================*/
+void showAlarm(char cls)
+{
+	char first = (alarmWaiting & (1 << cls)) ? TRUE : FALSE;
+	alarmWaiting &= ~(1 << cls);
+	alarmNow = cls;
+	if(cls == ALM_FLAME)
+	{
+		flameAlarm();
+	}
+	else if(cls == ALM_SMOKE)
+	{
+		smokeAlarm();
+	}
+	else
+	{
+		tempAlarm();
+	}
+	if(first)
+	{
+		alarmDrawing |= 1 << cls;	// queued by the flush above
+	}
+}//showAlarm::
+/*>>> timeAlarms: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		Once lcdISR has sent everything queued, this function keeps the ticks
+			each alarm in alarmDrawing took from its raising to its text being 
+			on the LCD in alarmLat and alarmLatMax
+Input:		None
+Returns:	None
+============================================================================*/
+void timeAlarms(void)
+{
+	char cls = FALSE;
+	unsigned int raised = FALSE;
+	if(!alarmDrawing || !lcdDone)
+	{
+		return;
+	}
+	for(cls = 0; cls < ALMCOUNT; cls++)
+	{
+		if(alarmDrawing & (1 << cls))
 		{
-			ALARMBUZZER = TRUE;
-		}		
-		Delay10KTCYx(100);
-		ALARMLED = FALSE;
-		ALARMBUZZER = FALSE;
-		Delay10KTCYx(40);
-		almRST();
-		ALARMLED = TRUE;
-		if(!alarmRST)
+			INTCONbits.GIEH = FALSE;	// alarmISR writes the stamps
+			raised = alarmRaised[cls];
+			INTCONbits.GIEH = TRUE;
+			alarmLat[cls] = getTicks() - raised;
+			if(alarmLat[cls] > alarmLatMax[cls])
+			{
+				alarmLatMax[cls] = alarmLat[cls];
+			}
+		}
+	}
+	alarmDrawing = FALSE;
+}//timeAlarms::
+/*>>> annunciate: ===========================================================
+Author:		
+Date:		
+Modified:	None
+Desc:		Run on every pass of the main loop, this function decides which active
+			alarm has the display and buzzer. A newly raised alarm of a higher 
+			class than the one annunciated takes over at once. Otherwise the 
+			alarm keeps them until its pattern has played, and then they go to 
+			the next active alarm in class order, so every active alarm gets its
+			turn however long a higher one stays active
+Input:		None
+Returns:	None
+============================================================================*/
+void annunciate(void)
+{
+	char cls = FALSE;
+	char next = ALMNONE;
+	char last = (alarmNow == ALMNONE) ? ALMCOUNT - 1 : alarmNow;
+	for(cls = 0; cls < alarmNow && next == ALMNONE; cls++)	// preempting
+	{
+		if(alarmWaiting & (1 << cls))
 		{
-			ALARMBUZZER = TRUE;
-		}		
-		Delay10KTCYx(100);
-		ALARMLED = FALSE;
-		ALARMBUZZER = FALSE;
-		Delay10KTCYx(40);
-		almRST();
-		ALARMLED = TRUE;
-		if(!alarmRST)
+			next = cls;
+		}
+	}
+	if(next == ALMNONE && patPlaying && (alarmSet & (1 << alarmNow)))
+	{
+		return;		// the alarm keeps its turn
+	}
+	for(cls = 1; cls <= ALMCOUNT && next == ALMNONE; cls++)	// rotating
+	{
+		if(alarmSet & (1 << ((last + cls) % ALMCOUNT)))
 		{
-			ALARMBUZZER = TRUE;
-		}		
-		Delay10KTCYx(100);
-		ALARMLED = FALSE;
-		ALARMBUZZER = FALSE;
-		count = 0;	
-	}		
-	Delay10KTCYx(20);	
-	WriteCmdXLCD(0x01);             // Clear display
-	Delay10KTCYx(2);
-}//smokeAlarm::
+			next = (last + cls) % ALMCOUNT;
+		}
+	}
+	if(next != ALMNONE)
+	{
+		showAlarm(next);
+	}
+}//annunciate::
 /*>>> serviceMode: ===========================================================
 Author:		Shubham
 Date:		25/07/2024
@@ -475,26 +856,20 @@ Returns:	None
 ============================================================================*/
 void serviceMode()
 {
-	char count = 0;
 	char serviceMode[]={" !!SERVICE--MODE!!"};
-	
-	SetDDRamAddr(0x80);		
-	Delay1KTCYx(10);
-	
 	if(smokeFlag)
 	{
 		SYSTEMOK=FALSE;
-		while(serviceMode[count] != '\0')
+		lcdClear();
+		lcdPuts(0x80, serviceMode);
+		lcdFlush();
+		if(holdDisplay(MSGHOLD))
 		{
-			WriteDataXLCD(serviceMode[count]);
-			count++;
-			Delay10KTCYx(50);
+			return;
 		}
-		while(BusyXLCD());
 	}		
-	Delay10KTCYx(20);	
-	WriteCmdXLCD(0x01);             // Clear display
-	Delay10KTCYx(2);
+	lcdClear();
+	lcdFlush();
 }//serviceMode::
 /*>>> lockMessage: ===========================================================
 Author:		Shubham
@@ -505,42 +880,35 @@ Returns:	None
 ============================================================================*/
 void lockMessage()
 {
-	char count = 0;
 	char message1[]={" SAFE UNLOCKED "};
 	char message2[]={" DOOR UNLOCKED "};
-	
-	SetDDRamAddr(0x80);
-	Delay1KTCYx(10);	
-	while(message1[count] != '\0')
-	{
-		WriteDataXLCD(message1[count]);
-		count++;
-		Delay10KTCYx(50);
-	}	
-	Delay1KTCYx(100);
-	SetDDRamAddr(0x80);
-	count = FALSE;	
-	while(message2[count] != '\0')
-	{
-		WriteDataXLCD(message2[count]);
-		count++;
-		Delay10KTCYx(50);
-	}
-	while(BusyXLCD());				
-	Delay10KTCYx(20);	
-	WriteCmdXLCD(0x01);             // Clear display
-	Delay10KTCYx(2);
+	lcdClear();
+	lcdPuts(0x80, message1);
+	lcdFlush();
+	if(holdDisplay(MSGHOLD))
+	{
+		return;		// the alarm takes the display
+	}
+	lcdPuts(0x80, message2);	// only SAFE to DOOR is sent
+	lcdFlush();
+	if(holdDisplay(MSGHOLD))
+	{
+		return;
+	}
+	lcdClear();
+	lcdFlush();
 }//lockMessage::
 /*>>> systemStatus: ===========================================================
 Author:		Shubham
 Date:		06/07/2024
 Modified:	NoNe 
-Desc:		This function displays status of different sensor status
+Desc:		This function displays status of different sensor status, then the 
+			longest alarm display latency of each class in ticks. A newly 
+			raised alarm ends the sequence at once
 Returns:	None
 ============================================================================*/
 void systemStatus()
 {
-	char count = 0;
 	char sensors[]={" !Sensor Status!"};
 	char tempOk[]={"Temp:OK"};
 	char FlameOk[]={"Flame:OK "};
@@ -548,118 +916,46 @@ void systemStatus()
 	char tempF[]={"Temp:FL"};
 	char FlameF[]={"Flame:FL"};
 	char smokeF[]={"    Smoke:FL   "};
-	SetDDRamAddr(0x80);		
-	Delay1KTCYx(10);
-	
-	while(sensors[count] != '\0')
-	{
-		WriteDataXLCD(sensors[count]);
-		count++;
-		Delay10KTCYx(50);
-	}
-	while(BusyXLCD());	
-	Delay10KTCYx(250);
-	SetDDRamAddr(0x40);	
-	Delay10KTCYx(50);
-	count = 0;
-	if(tempFlag)
+	char latency[LATLINE];
+	lcdClear();
+	lcdPuts(0x80, sensors);
+	lcdFlush();
+	if(holdDisplay(STATUSHOLD))
 	{
-		while(tempF[count] != '\0')
-		{
-			WriteDataXLCD(tempF[count]);
-			count++;
-			Delay10KTCYx(100);
-		}
+		return;		// the alarm takes the display
 	}
-	else
+	lcdPuts(0x40, tempFlag ? tempF : tempOk);
+	lcdFlush();
+	if(holdDisplay(STATUSHOLD))
 	{
-		while(tempOk[count] != '\0')
-		{
-			WriteDataXLCD(tempOk[count]);
-			count++;
-			Delay10KTCYx(100);
-		}
-	}	
-	while(BusyXLCD());
-	Delay10KTCYx(250);
-	SetDDRamAddr(0x48);	
-	Delay10KTCYx(50);
-	count = 0;
-	if(flameFlag)
-	{
-		while(FlameF[count] != '\0')
-		{
-			WriteDataXLCD(FlameF[count]);
-			count++;
-			Delay10KTCYx(100);
-		}
+		return;
 	}
-	else
+	lcdPuts(0x48, flameFlag ? FlameF : FlameOk);
+	lcdFlush();
+	if(holdDisplay(STATUSHOLD))
 	{
-		while(FlameOk[count] != '\0')
-		{
-			WriteDataXLCD(FlameOk[count]);
-			count++;
-			Delay10KTCYx(100);
-		}
+		return;
 	}
-	
-	while(BusyXLCD());
-	Delay10KTCYx(250);
-	SetDDRamAddr(0x40);	
-	Delay10KTCYx(50);
-	count = 0;
-	if(smokeFlag)
+	lcdPuts(0x40, smokeFlag ? smokeF : smokeOk);
+	lcdFlush();
+	if(holdDisplay(STATUSHOLD))
 	{
-		while(smokeF[count] != '\0')
-		{
-			WriteDataXLCD(smokeF[count]);
-			count++;
-			Delay10KTCYx(100);
-		}
+		return;
 	}
-	else
+	lcdClear();
+	strcpypgm2ram(latency, "Alarm lat 10ms");
+	lcdPuts(0x80, latency);
+	sprintf(latency, "F%u S%u T%u", alarmLatMax[ALM_FLAME], alarmLatMax[ALM_SMOKE], 
+		alarmLatMax[ALM_TEMP]);
+	lcdPuts(0x40, latency);
+	lcdFlush();
+	if(holdDisplay(STATUSHOLD))
 	{
-		while(smokeOk[count] != '\0')
-		{
-			WriteDataXLCD(smokeOk[count]);
-			count++;
-			Delay10KTCYx(100);
-		}	
-	}
-	
-	while(BusyXLCD());
-	Delay10KTCYx(250);	
-	WriteCmdXLCD(0x01);             // Clear display
-	Delay10KTCYx(20);
-	
-}//systemStatus::
-/*>>> status: ===========================================================
-Author:		Shubham
-Date:		06/07/2024
-Modified:	NoNe 
-Desc:		This function call teh status function on pressing status PB
-Input: 		None
-Returns:	None
-============================================================================*/
-
-void status(void)
-{
-	char count = FALSE;
-	if(!STATUSPB)
-	{			
-		while(!count)
-		{
-			count = 1;
-			systemStatus();
-			if(!STATUSPB)
-			{
-				break;
-			}
-		}
-					
+		return;
 	}
-}//status::
+	lcdClear();
+	lcdFlush();
+}//systemStatus::
 
 /*>>> systemInit: ===========================================================
 Author:		Shubham
@@ -685,6 +981,10 @@ void systemInit()
 	LATC=0X00;
 	TRISC =0xC3;
 	setOsc();
+	configTMR2();
+	configTMR6();
+	configINTS();
+	configPwrMgmt(TICKCYCLES, DUTYTICKS);	// Timer1 cycle counts, SLEEP enters IDLE
 }//systemInit::
 
 /*--- MAIN: FUNCTION ----------------------------------------------------------
@@ -705,33 +1005,54 @@ void main( void )
 	char pbMask = 0x10;
 	char rFlag = FALSE;
 	char mFlag = FALSE;
+	unsigned char key = FALSE;
 	MAINTENANCEMODE_LED = FALSE;
 	CONTROLLED= FALSE;
 	systemInit();
-	OpenXLCD(EIGHT_BIT & LINES_5X7);
-	SetDDRamAddr(0x83);
-	Delay10KTCYx(20);
+	lcdOpen();
 	introMessage(display,shiftMessage);	
+	holdDisplay(MSGHOLD);
 	userMode(line1,line2);
 	while(TRUE)
 	{
-		almRST();
-		//checking alarms
-		flameFlag = FLAMEALARM;
-		smokeFlag = SMOKEALARM;
-		//UNLOACKING SAFE AND DOOR
-		if(!UNLOCKPB&& mFlag)// if loop to unlock when unlock PB is pressed
+		sampleAlarms();		//checking alarms
+		//acting on the pushbutton events in the order they happened
+		key = readKey();
+		while(key)
 		{
-			count =1;
-			UNLOCKOUT = TRUE;			
-			MASTERON_OFF= FALSE;
-			lockMessage();
-		}//eo if
-		else if(UNLOCKPB)
-		{
-			UNLOCKOUT = FALSE;//resetting the output
-			
-		}//eo else if
+			switch(key)
+			{
+				case KEY_PRESS | PB_STATUS:
+					systemStatus();
+					break;
+				case KEY_PRESS | PB_RST:	//ALARM RESET(BUZZER OFF/ON)
+					alarmRST = !alarmRST;
+					break;
+				case KEY_PRESS | PB_UNLOCK:	//UNLOACKING SAFE AND DOOR
+					if(mFlag)
+					{
+						UNLOCKOUT = TRUE;			
+						MASTERON_OFF= FALSE;
+						lockMessage();
+					}
+					break;
+				case KEY_RELEASE | PB_UNLOCK:
+					UNLOCKOUT = FALSE;//resetting the output
+					break;
+				case KEY_PRESS | PB_REMOX:	//MAINTENANCE MODE on and off
+					rFlag = !rFlag;
+					MAINTENANCEMODE_LED = rFlag;
+					REMOXOUT = rFlag;
+					if(rFlag)
+					{
+						serviceMode();
+					}
+					break;
+				default:			// no other event has an action
+					break;
+			}
+			key = readKey();
+		}
 		
 		if(MASTERLOCK_IN&&!mFlag)//if loop to check the master lock signal from other PIC
 		{
@@ -744,47 +1065,39 @@ void main( void )
 		}
 		//SYSTEM OK INDICATOR
 		//if loop to display greeting message if there is no alarm and turn on status ok LED
-		if(!tempFlag&&!smokeFlag&&!flameFlag&&!DISPLAYON)
+		if(!tempFlag&&!smokeFlag&&!flameFlag&&KEYDOWN(PB_DISPLAY))
 		{
 			SYSTEMOK=TRUE;
 			introMessage(display,shiftMessage);
 			DISPLAYONLED = TRUE;		
 		}
-		status();
 		//DOOR SYSTEM
 		if(!smokeFlag&&!flameFlag)
 		{
 			DOORLOCKLED = FALSE;
 		}
-		else if(tempFlag||DISPLAYON)
+		else if(tempFlag||!KEYDOWN(PB_DISPLAY))
 		{
 			DOORLOCKLED= TRUE;
 		}
 
-		status();
 		//If loop to display alarm if any alarm signal is detected
 		if((tempFlag||smokeFlag||flameFlag)&&!REMOXOUT)
 		{
-			almRST();
-			tempAlarm();
-			flameAlarm();
-			smokeAlarm();
+			annunciate();
 		}
-		//if loop to go into MAINTENANCE MODE 
-		if (!REMOXIN&&!rFlag)
-		{
-			rFlag = TRUE;	
-			MAINTENANCEMODE_LED = TRUE;
-			REMOXOUT = TRUE;
-			serviceMode();
-
-		}//eo if
-		else if(rFlag&&!REMOXIN)
+		else
 		{
-			REMOXOUT = FALSE;
-			MAINTENANCEMODE_LED = FALSE;
-			rFlag= FALSE;
-		}//eo else if	
+			stopPattern();
+			alarmNow = ALMNONE;
+			if(REMOXOUT)
+			{
+				alarmWaiting = FALSE;	// held back on purpose, not waiting
+			}
+		}
+		timeAlarms();
+		updateDuty();
+		idleUntilWake();	// waiting for the next tick or alarm input change
 	}
 } // eo main::
 
@@ -0,0 +1,35 @@
+/*-----------------------------------------------------------------------------
+File Name:	nodeFrame.h
+Author:	
+Date:		
+Modified:	None
+ 
+Description:	Layout of the binary frames the nodes exchange on the serial 
+link: sync, node id, type, payload length, payload and the CRC-16 of 
+the node id to payload bytes, high byte first. Every payload starts 
+with a sequence number. The sender and receiver size their buffers 
+from these constants, and compute the CRC with crc16Update from 
+nodeFrame.c, so a change here reaches both ends.
+ 
+-----------------------------------------------------------------------------*/
+#ifndef NODEFRAME_H
+#define NODEFRAME_H
+ 
+#define FRMSYNC 		0xA5	// first byte of every frame
+#define FIRENODE 		0x01	// node id of the fire detection system
+#define EVACNODE 		0x02	// node id of the evacuation system
+#define FRM_ALM 		0x01	// fire channel raised the alarm
+#define FRM_CLR 		0x02	// fire channel cleared the alarm
+#define FRM_SEN 		0x03	// periodic fire sensor values, doubles as keep-alive
+#define FRM_FLT 		0x04	// tray fault
+#define FRMHEAD 		4	// sync, node id, type and length
+#define FRMCRC 			2	// CRC-16 high and low bytes
+#define CRCINIT 		0xFFFF	// CRC-16/CCITT preset
+#define FIRECHMAX 		16	// most fire channels, one bit each in the receiver's mask
+#define SENHEAD 		6	// seq, duty and the two cycle figures ahead of the values
+#define SENLEN(n) 		(SENHEAD + 2 * (n))	// sensor frame payload for n channels
+#define FRMMAX 			SENLEN(FIRECHMAX)	// longest payload, a full sensor frame
+ 
+unsigned int crc16Update(unsigned int crc, unsigned char byte);
+ 
+#endif
@@ -0,0 +1,116 @@
+/*-----------------------------------------------------------------------------
+File Name:	nodeIsr.c
+Author:	
+Date:		
+Modified:	None
+ 
+Description:	Interrupt vectors and dispatch shared by every node, see 
+nodeIsr.h.
+ 
+-----------------------------------------------------------------------------*/
+ 
+// Libraries ------------------------------------------------------------------
+#include <p18f45k22.h>
+#include "nodeIsr.h"
+#include "nodePower.h"
+ 
+// Constants  -----------------------------------------------------------------
+#define TRUE		1
+#define FALSE		0
+#define BYTESIZE	8
+ 
+// Global Variables  ----------------------------------------------------------
+volatile unsigned char entryLow = FALSE;	// Timer1 when the high vector was taken, stored by the vector
+volatile unsigned char entryHigh = FALSE;	// its high byte, latched by reading the low byte
+volatile unsigned int isrEntry = FALSE;		// Timer1 count when the high vector was taken
+volatile unsigned int highCyclesMax[ISRMAX];	// worst handler time of each high source
+volatile unsigned int lowCyclesMax[ISRMAX];	// worst handler time of each low source
+ 
+// Interrupt Vectors ----------------------------------------------------------
+// The high vector stores Timer1 before the context save; MOVFF leaves WREG
+// and STATUS alone, so the count is taken 3 to 4 cycles after the source.
+#pragma code interrupt_vector = 0x08
+void interrupt_vector(void)
+{
+_asm
+MOVFF TMR1L, entryLow
+MOVFF TMR1H, entryHigh
+GOTO highISR
+_endasm
+}
+#pragma code low_vector = 0x18
+void low_vector(void)
+{
+_asm
+GOTO lowISR
+_endasm
+}
+#pragma code 
+ 
+#pragma interrupt highISR save=section(".tmpdata")
+/*>>> highISR: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		It assembles the Timer1 count the vector stored into isrEntry, calls 
+the handler of every pending source in highTable and keeps the worst 
+Timer1 time of each handler in highCyclesMax.
+Input: 		None
+Returns:	None
+============================================================================*/
+void highISR(void)
+{
+char src = FALSE;
+unsigned int start = FALSE;
+unsigned int cycles = FALSE;
+isrEntry = entryLow;
+isrEntry |= (unsigned int)entryHigh<<BYTESIZE;
+for(src = 0; src < ISRMAX && highTable[src].handler; src++)
+{
+if(!highTable[src].flagReg || ((*highTable[src].flagReg & highTable[src].flagMask) && (*highTable[src].enableReg & highTable[src].enableMask)))
+{
+start = TMR1L;
+start |= (unsigned int)TMR1H<<BYTESIZE;
+highTable[src].handler();
+cycles = TMR1L;
+cycles |= (unsigned int)TMR1H<<BYTESIZE;
+cycles -= start;
+if(cycles > highCyclesMax[src])
+{
+highCyclesMax[src] = cycles;
+}
+}
+}
+} // eo highISR ::
+ 
+#pragma interruptlow lowISR save=section(".tmpdata")
+/*>>> lowISR: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		It calls the handler of every pending source in lowTable and keeps the
+worst Timer1 time of each handler in lowCyclesMax. The high vector also
+reads Timer1, so readTMR1 holds it off for each reading. A handler 
+preempted by the high vector is charged for that time too.
+Input: 		None
+Returns:	None
+============================================================================*/
+void lowISR(void)
+{
+char src = FALSE;
+unsigned int start = FALSE;
+unsigned int cycles = FALSE;
+for(src = 0; src < ISRMAX && lowTable[src].handler; src++)
+{
+if(!lowTable[src].flagReg || ((*lowTable[src].flagReg & lowTable[src].flagMask) && (*lowTable[src].enableReg & lowTable[src].enableMask)))
+{
+start = readTMR1();
+lowTable[src].handler();
+cycles = readTMR1() - start;
+if(cycles > lowCyclesMax[src])
+{
+lowCyclesMax[src] = cycles;
+}
+}
+}
+} // eo lowISR ::
@@ -0,0 +1,41 @@
+/*-----------------------------------------------------------------------------
+File Name:	nodeIsr.h
+Author:	
+Date:		
+Modified:	None
+ 
+Description:	Interrupt dispatch shared by every node. Each vector walks the 
+node's table in order, calling the handler of every source whose flag
+and enable bits are both set. A new source is a new row. Each node 
+defines highTable and lowTable, ends each with a row whose handler is
+NULL, and adds nodeIsr.c to its project. A row with a NULL flagReg 
+runs on every entry of its vector.
+Both vectors save only .tmpdata, so a handler must not call the C18 
+math library (division, 32 bit multiplication), whose MATH_DATA is 
+not saved; scale with shifts instead.
+ 
+-----------------------------------------------------------------------------*/
+#ifndef NODEISR_H
+#define NODEISR_H
+ 
+#define ISRMAX 		6	// most rows in a node's highTable or lowTable
+ 
+typedef struct
+{
+volatile near unsigned char *flagReg;	// register holding the interrupt flag, NULL for every entry
+unsigned char flagMask;
+volatile near unsigned char *enableReg;	// register holding the enable bit
+unsigned char enableMask;
+void (*handler)(void);			// services the source and clears its flag, NULL ends the table
+} isrSource_t;
+ 
+extern const rom isrSource_t highTable[];	// defined by the node
+extern const rom isrSource_t lowTable[];	// defined by the node
+extern volatile unsigned int isrEntry;		// Timer1 count when the high vector was taken
+extern volatile unsigned int highCyclesMax[ISRMAX];	// worst handler time of each high source
+extern volatile unsigned int lowCyclesMax[ISRMAX];	// worst handler time of each low source
+ 
+void highISR(void);
+void lowISR(void);
+ 
+#endif
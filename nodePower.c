@@ -0,0 +1,141 @@
+/*-----------------------------------------------------------------------------
+File Name:	nodePower.c
+Author:	
+Date:		
+Modified:	None
+ 
+Description:	Power layer shared by every node, see nodePower.h. Timer1 runs
+free at Fosc/4, so its counts are instruction cycles; the 10ms tick 
+bounds every idle period, so a 16 bit difference of two reads never 
+wraps.
+ 
+-----------------------------------------------------------------------------*/
+ 
+// Libraries ------------------------------------------------------------------
+#include <p18f45k22.h>
+#include "nodePower.h"
+ 
+// Constants  -----------------------------------------------------------------
+#define TRUE		1
+#define FALSE		0
+#define BYTESIZE	8
+#define T1RD16ON	0x03		// Timer1 on, Fosc/4, 16 bit reads
+#define INTGON		0xC0		// GIEH and GIEL in INTCON
+ 
+// Global Variables  ----------------------------------------------------------
+volatile unsigned int tickCount = FALSE;	// 10ms Timer2 ticks
+char dutyCycle = 100;			// percent of the last duty period the core was running
+unsigned long idleCycles = FALSE;	// cycles spent in IDLE since the last duty figure
+unsigned int dutyTick = FALSE;		// tick of the last duty figure
+unsigned int tickCyclesCfg = FALSE;	// instruction cycles per tick of this node
+unsigned int dutyTicksCfg = FALSE;	// ticks per duty cycle figure of this node
+ 
+/*>>> configPwrMgmt: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		It starts Timer1 free running for the cycle counts and makes the SLEEP
+instruction enter IDLE mode, so the timers, the ADC and the USARTs keep
+running and their interrupts wake the core.
+Input: 		unsigned int tickCycles, instruction cycles per 10ms tick.
+unsigned int dutyTicks, ticks per duty cycle figure.
+Returns:	None
+============================================================================*/
+void configPwrMgmt(unsigned int tickCycles, unsigned int dutyTicks)
+{
+tickCyclesCfg = tickCycles;
+dutyTicksCfg = dutyTicks;
+T1CON = T1RD16ON;
+OSCCONbits.IDLEN = TRUE;
+} // eo configPwrMgmt ::
+ 
+/*>>> getTicks: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		It reads the 16 bit tick count with the Timer2 interrupt held off so 
+that both bytes belong to the same tick.
+Input: 		None
+Returns:	unsigned int, the number of 10ms ticks since start up.
+============================================================================*/
+unsigned int getTicks(void)
+{
+unsigned int ticks = FALSE;
+PIE1bits.TMR2IE = FALSE;
+ticks = tickCount;
+PIE1bits.TMR2IE = TRUE;
+return ticks;
+} // eo getTicks ::
+ 
+/*>>> readTMR1: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		It reads the free running Timer1, low byte first so that the high byte
+is latched. The interrupt handlers read Timer1 too, so they are held
+off between the two bytes.
+Input: 		None
+Returns:	unsigned int, the Timer1 count in instruction cycles.
+============================================================================*/
+unsigned int readTMR1(void)
+{
+char gie = INTCONbits.GIEH;
+unsigned int count = FALSE;
+INTCONbits.GIEH = FALSE;
+count = TMR1L;
+count |= (unsigned int)TMR1H<<BYTESIZE;
+INTCONbits.GIEH = gie;
+return count;
+} // eo readTMR1 ::
+ 
+/*>>> idleUntilWake: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		It idles the core until the next interrupt and adds the time spent idle
+to idleCycles. The interrupts are held off across the SLEEP, which 
+still wakes the core but does not vector, so the end of the idle 
+time is stamped before the waking handler runs and its work counts
+as busy time.
+Input: 		None
+Returns:	None
+============================================================================*/
+void idleUntilWake(void)
+{
+unsigned char gie = INTCON & INTGON;
+unsigned int start = FALSE;
+INTCON &= ~INTGON;
+start = readTMR1();
+Sleep();
+Nop();
+idleCycles += (unsigned int)(readTMR1() - start);
+INTCON |= gie;		// the waking handler runs now
+} // eo idleUntilWake ::
+ 
+/*>>> updateDuty: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		Once a duty period has passed, it turns the idle time of that period 
+into the percentage of time the core was running, kept in dutyCycle.
+Input: 		None
+Returns:	char, TRUE when dutyCycle holds a new figure.
+============================================================================*/
+char updateDuty(void)
+{
+unsigned int now = getTicks();
+unsigned int ticks = now - dutyTick;
+unsigned long total = (unsigned long)ticks*tickCyclesCfg;
+if(ticks < dutyTicksCfg || !total)
+{
+return FALSE;
+}
+if(idleCycles > total)
+{
+idleCycles = total;
+}
+dutyCycle = 100 - (idleCycles*100)/total;
+idleCycles = FALSE;
+dutyTick = now;
+return TRUE;
+} // eo updateDuty ::
@@ -0,0 +1,26 @@
+/*-----------------------------------------------------------------------------
+File Name:	nodePower.h
+Author:	
+Date:		
+Modified:	None
+ 
+Description:	Power layer shared by every node: the 10ms tick count, the free 
+running Timer1 cycle counter, idling between interrupts and the duty
+cycle figure worked out from the time spent idle. Each node counts 
+tickCount in its Timer2 tick handler and passes its own clock figures
+to configPwrMgmt.
+ 
+-----------------------------------------------------------------------------*/
+#ifndef NODEPOWER_H
+#define NODEPOWER_H
+ 
+extern volatile unsigned int tickCount;	// 10ms Timer2 ticks, counted by the node
+extern char dutyCycle;			// percent of the last duty period the core was running
+ 
+void configPwrMgmt(unsigned int tickCycles, unsigned int dutyTicks);
+unsigned int getTicks(void);
+unsigned int readTMR1(void);
+void idleUntilWake(void);
+char updateDuty(void);
+ 
+#endif
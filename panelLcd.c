@@ -0,0 +1,259 @@
+/*-----------------------------------------------------------------------------
+File Name:	panelLcd.c
+Author:	
+Date:		
+Modified:	None
+ 
+Description:	LCD driver shared by the panel nodes, see panelLcd.h. The 
+application draws into lcdShadow; lcdFlush queues only the cells that
+differ from lcdShown, and lcdISR sends the queue one transfer per 
+Timer6 period, so the foreground never waits on the LCD busy flag.
+ 
+-----------------------------------------------------------------------------*/
+ 
+// Libraries ------------------------------------------------------------------
+#include <p18f45k22.h>
+#include <string.h>
+#include "xlcd.h"
+#include "nodePower.h"
+#include "panelLcd.h"
+ 
+// Constants  -----------------------------------------------------------------
+#define TRUE		1
+#define FALSE		0
+#define LCDROWS 2			// lines of the LCD
+#define LCDCOLS 16			// characters per line
+#define LCDCLEAR 0x01			// clear display command
+#define BLANK ' '
+#define ROWMASK 0x40			// DDRAM address bit of the second line
+#define COLMASK 0x3F			// DDRAM address bits of the column
+#define NOCURSOR 0xFF			// the LCD cursor is not at a known cell
+#define LINE1_LCD 0x00			// start of line 1
+#define LINE2_LCD 0x40			// start of line 2
+#define LCDQSIZE 64			// LCD transfer queue size, a power of 2
+#define LCDQMASK (LCDQSIZE - 1)
+#define LCD_CMD 0			// kinds of queued LCD transfer
+#define LCD_ADDR 1
+#define LCD_DATA 2
+#define T6LCD 0x05			// Timer6 on, 1:4 prescale, 1:1 postscale
+#define PR6LCD 99			// 100us LCD transfer period at 16MHz
+ 
+// Global Variables  ----------------------------------------------------------
+char lcdShadow[LCDROWS][LCDCOLS];	// screen drawn by the application
+char lcdShown[LCDROWS][LCDCOLS];	// screen held by the LCD
+unsigned char lcdWrites = FALSE;	// bus transfers of the last flush
+unsigned int lcdCycles = FALSE;		// Timer1 cycles of the last flush
+unsigned int lcdCyclesMax = FALSE;	// worst flush
+char lcdKinds[LCDQSIZE];		// LCD_CMD, LCD_ADDR or LCD_DATA of each queued transfer
+char lcdBytes[LCDQSIZE];		// command, address or character of each queued transfer
+volatile unsigned char lcdHead = FALSE;	// next free slot, written by the foreground only
+volatile unsigned char lcdTail = FALSE;	// next transfer to send, written by lcdISR only
+volatile char lcdDone = TRUE;		// TRUE once lcdISR has sent everything queued
+unsigned int lcdStalls = FALSE;		// waits for room in a full queue
+ 
+void lcdPush(char kind, char byte);
+ 
+/*>>> configTMR6: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		It configures Timer6 for the 100us period at 16MHz that paces the LCD
+transfers. The node enables its interrupt as a low priority source
+dispatching lcdISR.
+Input: 		None
+Returns:	None
+============================================================================*/
+void configTMR6(void)
+{
+TMR6 = FALSE;
+PR6 = PR6LCD;
+T6CON = T6LCD;
+} // eo configTMR6 ::
+ 
+/*>>> lcdOpen: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		It opens the LCD, which clears it, and blanks both framebuffers to match.
+It waits for the queue to drain first, as only lcdISR may use the bus
+until then.
+Input: 		None
+Returns:	None
+============================================================================*/
+void lcdOpen(void)
+{
+while(!lcdDone)		// lcdISR owns the bus until the queue drains
+{
+idleUntilWake();
+}
+OpenXLCD(EIGHT_BIT & LINES_5X7);
+memset(lcdShown, BLANK, sizeof(lcdShown));
+memset(lcdShadow, BLANK, sizeof(lcdShadow));
+} // eo lcdOpen ::
+ 
+/*>>> lcdClear: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		It blanks the shadow framebuffer; the LCD changes on the next lcdFlush.
+Input: 		None
+Returns:	None
+============================================================================*/
+void lcdClear(void)
+{
+memset(lcdShadow, BLANK, sizeof(lcdShadow));
+} // eo lcdClear ::
+ 
+/*>>> lcdPuts: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		It writes a message into the shadow framebuffer, cut at the end of the line
+Input: 		unsigned char addr, the DDRAM address of the first character 
+(0x80 or 0x00 based for line 1, 0x40 or 0xC0 based for line 2)
+char *text, the message.
+Returns:	None
+============================================================================*/
+void lcdPuts(unsigned char addr, char *text)
+{
+char row = (addr & ROWMASK) ? TRUE : FALSE;
+char col = addr & COLMASK;
+while(*text != '\0' && col < LCDCOLS)
+{
+lcdShadow[row][col] = *text;
+text++;
+col++;
+}
+} // eo lcdPuts ::
+ 
+/*>>> lcdPush: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		It queues one transfer for lcdISR and starts lcdISR if it had drained the
+queue. While the queue is full it idles until lcdISR makes room.
+Input: 		char kind, LCD_CMD, LCD_ADDR or LCD_DATA
+char byte, the command, DDRAM address or character.
+Returns:	None
+============================================================================*/
+void lcdPush(char kind, char byte)
+{
+unsigned char next = (lcdHead + TRUE) & LCDQMASK;
+while(next == lcdTail)		// full
+{
+lcdStalls++;
+idleUntilWake();
+}
+lcdKinds[lcdHead] = kind;
+lcdBytes[lcdHead] = byte;
+lcdHead = next;
+lcdDone = FALSE;
+PIE5bits.TMR6IE = TRUE;
+} // eo lcdPush ::
+ 
+/*>>> lcdISR: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		Every 100us while transfers are queued, it sends the next one if the LCD
+is not busy; a busy LCD is tried again on the next period. Once the
+queue is drained it sets lcdDone and stops its interrupt.
+Input: 		None
+Returns:	None
+============================================================================*/
+void lcdISR(void)
+{
+T6FLAG = FALSE;
+if(lcdTail != lcdHead && !BusyXLCD())
+{
+if(lcdKinds[lcdTail] == LCD_DATA)
+{
+WriteDataXLCD(lcdBytes[lcdTail]);
+}
+else if(lcdKinds[lcdTail] == LCD_ADDR)
+{
+SetDDRamAddr(lcdBytes[lcdTail]);
+}
+else
+{
+WriteCmdXLCD(lcdBytes[lcdTail]);
+}
+lcdTail = (lcdTail + TRUE) & LCDQMASK;
+}
+if(lcdTail == lcdHead)
+{
+PIE5bits.TMR6IE = FALSE;
+lcdDone = TRUE;
+}
+} // eo lcdISR ::
+ 
+/*>>> lcdFlush: ===========================================================
+Author:	
+Date:		
+Modified:	None
+Desc:		It queues for lcdISR only the cells of the shadow framebuffer that 
+changed and returns without waiting for them to be sent. The address 
+is only set where the changed cells are not contiguous, and when 
+clearing and redrawing is cheaper the clear command is used. The 
+transfers queued and the Timer1 cycles spent queuing them are kept in 
+lcdWrites and lcdCycles, the worst in lcdCyclesMax; lcdDone is set 
+once they have all been sent.
+Input: 		None
+Returns:	None
+============================================================================*/
+void lcdFlush(void)
+{
+unsigned int start = readTMR1();
+char row = FALSE;
+char col = FALSE;
+char changed = FALSE;
+char inked = FALSE;		// cells of the shadow that are not blank
+unsigned char addr = FALSE;
+unsigned char cursor = NOCURSOR;	// address the next data byte goes to
+lcdWrites = FALSE;
+for(row = 0; row < LCDROWS; row++)
+{
+for(col = 0; col < LCDCOLS; col++)
+{
+if(lcdShadow[row][col] != lcdShown[row][col])
+{
+changed++;
+}
+if(lcdShadow[row][col] != BLANK)
+{
+inked++;
+}
+}
+}
+if(inked + TRUE < changed)
+{
+lcdPush(LCD_CMD, LCDCLEAR);
+lcdWrites++;
+memset(lcdShown, BLANK, sizeof(lcdShown));
+cursor = LINE1_LCD;	// clearing homes the cursor
+}
+for(row = 0; row < LCDROWS; row++)
+{
+for(col = 0; col < LCDCOLS; col++)
+{
+if(lcdShadow[row][col] != lcdShown[row][col])
+{
+addr = (row ? LINE2_LCD : LINE1_LCD) + col;
+if(addr != cursor)
+{
+lcdPush(LCD_ADDR, addr);
+lcdWrites++;
+}
+lcdPush(LCD_DATA, lcdShadow[row][col]);
+lcdWrites++;
+lcdShown[row][col] = lcdShadow[row][col];
+cursor = addr + TRUE;
+}
+}
+}
+lcdCycles = readTMR1() - start;
+if(lcdCycles > lcdCyclesMax)
+{
+lcdCyclesMax = lcdCycles;
+}
+} // eo lcdFlush ::
@@ -0,0 +1,34 @@
+/*-----------------------------------------------------------------------------
+File Name:	panelLcd.h
+Author:	
+Date:		
+Modified:	None
+ 
+Description:	LCD driver shared by the panel nodes (Remote and passSys): a 
+shadow framebuffer diffed against the screen, and a transfer queue 
+that lcdISR drains from Timer6. Each node adds panelLcd.c to its 
+project, calls configTMR6, dispatches lcdISR from lowTable on 
+TMR6MASK, and provides the xlcd delay callbacks for its clock. 
+Timer6 is set up for a 16MHz clock.
+ 
+-----------------------------------------------------------------------------*/
+#ifndef PANELLCD_H
+#define PANELLCD_H
+ 
+#define T6FLAG PIR5bits.TMR6IF
+#define TMR6MASK 0x04			// TMR6IF in PIR5, TMR6IE in PIE5
+ 
+extern volatile char lcdDone;		// TRUE once lcdISR has sent everything queued
+extern unsigned char lcdWrites;		// bus transfers of the last flush
+extern unsigned int lcdCycles;		// Timer1 cycles of the last flush
+extern unsigned int lcdCyclesMax;	// worst flush
+extern unsigned int lcdStalls;		// waits for room in a full queue
+ 
+void configTMR6(void);
+void lcdOpen(void);
+void lcdClear(void);
+void lcdPuts(unsigned char addr, char *text);
+void lcdFlush(void);
+void lcdISR(void);
+ 
+#endif
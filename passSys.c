@@ -33,6 +33,9 @@
 #include <delays.h>
 #include "xlcd.h"
 #include <string.h>
+#include "nodePower.h"
+#include "nodeIsr.h"
+#include "panelLcd.h"
 
 
 // Constants  -----------------------------------------------------------------
@@ -59,6 +62,25 @@
 #define ONESEC 10
 #define ADCRES 0.00488281 		// ADC resolutions
 #define TEMPM 0.01
+#define TEMPCH 3			// ADC channel of the temperature sensor
+#define TEMPLIMIT 21			// temperature alarm limit
+#define ADCFLAG PIR1bits.ADIF		// ADC complete flag
+#define T2FLAG PIR1bits.TMR2IF		// Timer2 match flag
+#define T2TENMILSEC 0x4E		// Timer2 on, 1:16 prescale, 1:10 postscale
+#define PR2TENMILSEC 249		// 10ms period with T2TENMILSEC at 16MHz
+#define INTGON 0xC0			// GIEH and GIEL
+#define TMR2MASK 0x02			// TMR2IF in PIR1, TMR2IE in PIE1
+#define ADCMASK 0x40			// ADIF in PIR1, ADIE in PIE1
+#define SCANCOUNT 1			// channels in the ADC scan list
+#define FILTER_MEAN 0			// running sum over the last SAMPSIZE samples
+#define FILTER_EWMA 1			// exponential average, weight 1/2^EWMASHIFT
+#define FILTER_MEDIAN 2			// median of the last MEDIANSIZE samples
+#define EWMASHIFT 2
+#define MEDIANSIZE 3			// odd, no larger than SAMPSIZE
+#define TEMPFILTER FILTER_MEAN		// filter used for the temperature channel
+#define DUTYTICKS 100			// Timer2 ticks per duty cycle figure (1s)
+#define TICKCYCLES 40000		// instruction cycles per tick at 16MHz
+#define MSGHOLD 150			// ticks a message stays up (1.5s)
 
 // LCD Display Orientation Commands Constants ::::::::::::::::::::::::::::::::::::::
 #define LINE1_LCD		0x00	// Start of line 1
@@ -92,10 +114,8 @@
 char keyValue = FALSE;			
 char password[] ="456B#";		// default(correct) password
 char passFlag = FALSE;			// password flag
-int samplesArr[SAMPSIZE];		// array to store samples
 char trialCount = TOTAL_TRIALS;		// trial counter
 char trials[16] = {0};			// trial's array
-char trialsIndex = 0;			// trial index
 typedef int sensor_t;
 
 // Function Prototpyes ::::::::::::::::::::::::::::::::::::::::::::::::::::::::
@@ -107,12 +127,52 @@ typedef struct
 	sensor_t avgtime;
 	sensor_t full;
 	sensor_t empty;
+	long sum;			// running sum of samples[]
+	long ewma;			// EWMA state scaled by 2^EWMASHIFT
+	char mode;			// FILTER_MEAN, FILTER_EWMA or FILTER_MEDIAN
 	char insert;
 	char avgRdy;
 }sensorCh_t;
 
 sensorCh_t sensors;			// sensor's object
 
+/*Double buffered sample windows filled by the ADC interrupt*/
+typedef struct
+{
+	sensor_t win[2][SAMPSIZE];	// double buffered sample windows
+	char fill;			// window being filled by the ISR
+	char count;			// samples in the filling window
+	char ready;			// TRUE while the other window holds unread samples
+	char overrun;			// windows completed before the previous one was read
+}adcRing_t;
+
+volatile adcRing_t adcRings[SCANCOUNT];
+volatile char scanPos = SCANCOUNT;	// position of the conversion in progress
+const rom char scanList[SCANCOUNT] = {TEMPCH};	// ADC channel sampled by each ring
+int tempAvg = FALSE;			// last averaged temperature
+
+// Prototypes ::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+
+void tickISR(void);
+void adcISR(void);
+
+// Interrupt sources :::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+// Dispatched by nodeIsr.c, each table ends with a NULL handler.
+// timebase on the high vector
+const rom isrSource_t highTable[] =
+{
+	{&PIR1, TMR2MASK, &PIE1, TMR2MASK, tickISR},
+	{NULL, 0, NULL, 0, NULL}
+};
+
+// conversions and LCD transfers on the low vector
+const rom isrSource_t lowTable[] =
+{
+	{&PIR1, ADCMASK, &PIE1, ADCMASK, adcISR},
+	{&PIR5, TMR6MASK, &PIE5, TMR6MASK, lcdISR},
+	{NULL, 0, NULL, 0, NULL}
+};
+
 /*>>> setOsc: ===========================================================
 Author:		Shubham
 Date:		06/07/2024
@@ -202,6 +262,29 @@ void DelayXLCD (void)
  	return;
 }//DelayXLCD::
 
+/*>>> holdDisplay: ===========================================================
+Author:		
+Date:		
+Modified:	None
+Desc:		It keeps the screen as it is for a number of ticks, idling in between.
+		The hold starts once lcdISR has sent the queued text.
+Input: 		unsigned int ticks, the 10ms ticks to wait.
+Returns:	None
+============================================================================*/
+void holdDisplay(unsigned int ticks)
+{
+	unsigned int start = FALSE;
+	while(!lcdDone)		// still rendering
+	{
+		idleUntilWake();
+	}
+	start = getTicks();
+	while(getTicks() - start < ticks)
+	{
+		idleUntilWake();
+	}
+}//holdDisplay::
+
 /*>>> resetTMR0: ===========================================================
 Author:		Dhruv Satasiya
 Date:		06/07/2024
@@ -241,27 +324,13 @@ Returns:	None
 ============================================================================*/
 void userMode(char *ptr1,char *ptr2)
 {
-	SetDDRamAddr(0x80);		// This function is used to keep or set the 
-					// cursor at particular location.
-	Delay10KTCYx(40);
-	while(*ptr1 != '\0')
-	{
-		WriteDataXLCD(*ptr1);	// in-built XLCD function to write the data on LCD
-		ptr1++;
-		Delay10KTCYx(50);
-	}
-	Delay10KTCYx(20);
-	SetDDRamAddr(0x40);		// This function is used to keep or set the 									// cursor at particular location.
-	Delay10KTCYx(50);
-	while(*ptr2 != '\0')
-	{
-		WriteDataXLCD(*ptr2);
-		ptr2++;
-		Delay10KTCYx(50);
-	}
-	while(BusyXLCD());
-	WriteCmdXLCD(0x01);             // Clear display in-built function
-	Delay10KTCYx(20);
+	lcdClear();
+	lcdPuts(0x80, ptr1);		// first line
+	lcdPuts(0x40, ptr2);		// second line
+	lcdFlush();
+	holdDisplay(MSGHOLD);
+	lcdClear();
+	lcdFlush();
 }//userMode::
 
 /*>>> introMessage: ===========================================================
@@ -274,27 +343,13 @@ Returns:	None
 ============================================================================*/
 void introMessage(char *ptr1,char *ptr2)
 {
-	SetDDRamAddr(0x81);		// This function is used to keep or set the 
-					// cursor at particular location.
-	Delay10KTCYx(40);
-	while(*ptr1 != '\0')
-	{
-		WriteDataXLCD(*ptr1);	// in-built XLCD function to write the data on LCD
-		ptr1++;
-		Delay10KTCYx(50);
-	}
-	Delay10KTCYx(20);
-	SetDDRamAddr(0x42);		// This function is used to keep or set the 									// cursor at particular location.
-	Delay10KTCYx(50);
-	while(*ptr2 != '\0')
-	{
-		WriteDataXLCD(*ptr2);
-		ptr2++;
-		Delay10KTCYx(50);
-	}
-	while(BusyXLCD());
-	WriteCmdXLCD(0x01);             // Clear display
-	Delay10KTCYx(20);
+	lcdClear();
+	lcdPuts(0x81, ptr1);		// first line
+	lcdPuts(0x42, ptr2);		// second line
+	lcdFlush();
+	holdDisplay(MSGHOLD);
+	lcdClear();
+	lcdFlush();
 }//introMessage::
 
 /*>>> fillPass: ===========================================================
@@ -307,15 +362,8 @@ Returns:	None
 ============================================================================*/
 void fillPass(char *ptr)
 {
-	SetDDRamAddr(0x45);		// This function is used to keep Cursor at 2nd LINE at 5 position								// cursor at particular location.	
-	Delay1KTCYx(TRUE);
-	while(*ptr != '\0')
-	{
-		WriteDataXLCD(*ptr);
-		ptr++;
-		Delay10KTCYx(20);
-	}
-	while(BusyXLCD());	
+	lcdPuts(0x45, ptr);		// 2nd LINE at 5 position, only the new '*' is sent
+	lcdFlush();
 }//fillPass::
 
 /*>>> masterLock: ===========================================================
@@ -330,24 +378,10 @@ Returns:	None
 void masterLock()
 {
 	char masterLock[] = {"Master Locked"};
-	char masterCount = 0;
 
-	while(BusyXLCD());
-	WriteCmdXLCD(0x01);             // Clear display
-	Delay10KTCYx(20);
-
-	SetDDRamAddr(0x81);	
-	Delay10KTCYx(20);
-	Delay10KTCYx(20);
-
-	while(masterLock[masterCount] != '\0')			// while loop to print the master 
-								//lock message on LCD
-	{
-		WriteDataXLCD(masterLock[masterCount]);
-		masterCount++;
-		Delay10KTCYx(50);
-	}
-	Delay10KTCYx(20);
+	lcdClear();
+	lcdPuts(0x81, masterLock);	// master lock message on LCD
+	lcdFlush();
 
 	while(1)			// Indefinite loop to keep the door locked untill remote
 					// access is given to unlock the safe
@@ -375,49 +409,227 @@ void tempAlert()
 {
 	char alertMessage[] = {"!!TEMP ALERT!! "};	// Temperature alert message
 	char userMessage[] = {"!!SAFE LOCKED!! "};	// Safe Unlocked message
-	char count = 0;
-	Delay10KTCYx(20);
-	WriteCmdXLCD(0x01);             // Clear display
-	Delay10KTCYx(20);
-	SetDDRamAddr(0x81);		// This function is used to keep or set the 
-					// cursor at particular location.
-	Delay10KTCYx(20);
-	while(alertMessage[count] != '\0')
+	lcdClear();
+	lcdPuts(0x81, alertMessage);
+	lcdPuts(0x40, userMessage);
+	lcdFlush();			// nothing is sent while the alert stays up
+}//tempAlert::
+
+/*>>> configTMR2: ===========================================================
+Author:		
+Date:		
+Modified:	None
+Desc:		It Configures Timer2 for a 10ms period at 16 MHz to pace the ADC scan.
+Input: 		None
+Returns:	None
+============================================================================*/
+void configTMR2(void)
+{
+	TMR2 = FALSE;
+	PR2 = PR2TENMILSEC;
+	T2CON = T2TENMILSEC;
+}//configTMR2::
+
+/*>>> configINTS: ===========================================================
+Author:		
+Date:		
+Modified:	None
+Desc:		Initializes interrupts for Timer2 and the ADC so that conversions are 
+		started by the timer and collected in the ISR. The tick is high 
+		priority and the ADC low, as is the LCD transfer timer, which is only
+		enabled while transfers are queued.
+Input: 		None
+Returns:	None
+============================================================================*/
+void configINTS(void)
+{
+	T2FLAG = FALSE;
+	IPR1bits.TMR2IP = TRUE;
+	PIE1bits.TMR2IE = TRUE;		// Timer2 match starts an ADC scan
+	ADCFLAG = FALSE;
+	IPR1bits.ADIP = FALSE;
+	PIE1bits.ADIE = TRUE;		// ADC complete collects the result
+	T6FLAG = FALSE;
+	IPR5bits.TMR6IP = FALSE;	// Timer6 sends the queued LCD transfers
+
+	RCONbits.IPEN = TRUE;		// Global interrupt priority enabled
+	INTCON |= INTGON;		// Enable high and low priority interrupts
+}//configINTS::
+
+/*>>> tickISR: ===========================================================
+Author:		
+Date:		
+Modified:	None
+Desc:		On every Timer2 match this function counts the tick and starts a scan 
+		of scanList.
+Input: 		None
+Returns:	None
+============================================================================*/
+void tickISR(void)
+{
+	T2FLAG = FALSE;
+	tickCount++;
+	if(scanPos >= SCANCOUNT)	// previous scan finished
 	{
-		WriteDataXLCD(alertMessage[count]);
-		count++;
-		Delay10KTCYx(50);
+		scanPos = 0;
+		ADCON0bits.CHS = scanList[0];
+		ADCON0bits.GO = TRUE;
 	}
-	while(BusyXLCD());
-	Delay10KTCYx(20);
-	count =0;
-	SetDDRamAddr(0x40);		// This function is used to keep or set the 									// cursor at particular location.
-	Delay10KTCYx(50);
-	while(userMessage[count] != '\0')
+}//tickISR::
+
+/*>>> adcISR: ===========================================================
+Author:		
+Date:		
+Modified:	None
+Desc:		Each ADC complete interrupt stores the result in the filling window of 
+		that channel's ring, swaps windows once it is full and starts the next 
+		channel. The tick shares scanPos, so it is held off meanwhile.
+Input: 		None
+Returns:	None
+============================================================================*/
+void adcISR(void)
+{
+	ADCFLAG = FALSE;
+	INTCONbits.GIEH = FALSE;
+	if(scanPos < SCANCOUNT)
 	{
-		WriteDataXLCD(userMessage[count]);
-		count++;
-		Delay10KTCYx(50);
+		volatile adcRing_t *ring = &adcRings[scanPos];
+		ring->win[ring->fill][ring->count] = ADRES;
+		ring->count++;
+		if(ring->count >= SAMPSIZE)
+		{
+			if(ring->ready)
+			{
+				ring->overrun++;
+			}
+			ring->count = 0;
+			ring->fill ^= TRUE;
+			ring->ready = TRUE;
+		}
+		scanPos++;
+		if(scanPos < SCANCOUNT)
+		{
+			ADCON0bits.CHS = scanList[scanPos];
+			ADCON0bits.GO = TRUE;
+		}
 	}
-	while(BusyXLCD());
-	
-}//tempAlert::
+	INTCONbits.GIEH = TRUE;
+}//adcISR::
 
-/*>>> getADCSample: ===========================================================
-Author:		Shubham
-Date:		13/05/2024
+/*>>> getWindowAvg: ===========================================================
+Author:		
+Date:		
 Modified:	None
-Desc:		This function gets ADC value from the input channel.
-Input: 		char Chan is the channel number
-Returns:	int ADRES is the converted ADC
+Desc:		This function averages the completed window of a ring and releases it 
+		back to the ISR. It must only be called while the ring's ready flag is set.
+Input: 		char ringID is the ring whose completed window is to be read
+Returns:	int, the average ADC count of the window
  ============================================================================*/
-int getADCSample(char chan)
+int getWindowAvg(char ringID)
 {
-	ADCON0bits.CHS = chan;
-	ADCON0bits.GO = TRUE;
-	while(ADCON0bits.GO);		// waiting for the samples to be calculated
-	return ADRES;
-}
+	volatile adcRing_t *ring = &adcRings[ringID];
+	volatile sensor_t *win = ring->win[ring->fill ^ TRUE];
+	long sum = FALSE;
+	char index = FALSE;
+	for(index = FALSE;index<SAMPSIZE;index++)
+	{
+		sum += win[index];
+	}
+	ring->ready = FALSE;
+	return sum/SAMPSIZE;
+}//getWindowAvg::
+
+/*>>> initSensorCh: ===========================================================
+Author:		
+Date:		
+Modified:	None
+Desc:		This function initializes all the elements of the data structure sensorCh_t
+Input: 		sensorCh_t *sen is the channel to be initialized, char mode is its filter
+Returns:	None
+ ============================================================================*/
+void initSensorCh(sensorCh_t *sen, char mode)
+{
+	char index = FALSE;
+	for(index = FALSE;index<SAMPSIZE;index++)
+	{
+		sen->samples[index] = FALSE;
+	}
+	sen->avgtime = FALSE;
+	sen->full = FALSE;
+	sen->empty = FALSE;
+	sen->sum = FALSE;
+	sen->ewma = FALSE;
+	sen->mode = mode;
+	sen->insert = FALSE;
+	sen->avgRdy = FALSE;
+}//initSensorCh::
+
+/*>>> medianOf: ===========================================================
+Author:		
+Date:		
+Modified:	None
+Desc:		This function sorts the newest MEDIANSIZE samples of a channel by insertion
+		into a small local array and returns the middle one.
+Input: 		sensorCh_t *sen is the channel whose history is to be used
+Returns:	sensor_t, the median of the newest samples
+ ============================================================================*/
+sensor_t medianOf(sensorCh_t *sen)
+{
+	sensor_t sorted[MEDIANSIZE];
+	sensor_t value = FALSE;
+	char pos = sen->insert;
+	char count = FALSE;
+	char index = FALSE;
+	for(count = FALSE;count<MEDIANSIZE;count++)
+	{
+		pos = (pos == 0 ? SAMPSIZE : pos) - 1;	// walking back from the newest
+		value = sen->samples[pos];
+		for(index = count;index>0 && sorted[index-1]>value;index--)
+		{
+			sorted[index] = sorted[index-1];
+		}
+		sorted[index] = value;
+	}
+	return sorted[MEDIANSIZE/2];
+}//medianOf::
+
+/*>>> filterSample: ===========================================================
+Author:		
+Date:		
+Modified:	None
+Desc:		This function adds a new sample to the channel history, replacing the oldest
+		one in the running sum, and returns the filtered value. The cost does not 
+		depend on SAMPSIZE. avgRdy is set once the history has been filled.
+Input: 		sensorCh_t *sen is the channel, sensor_t sample is the new sample
+Returns:	sensor_t, the filtered value in the units of the samples
+ ============================================================================*/
+sensor_t filterSample(sensorCh_t *sen, sensor_t sample)
+{
+	sen->sum += (long)sample - sen->samples[sen->insert];
+	sen->samples[sen->insert] = sample;
+	sen->insert++;
+	if(sen->insert>=SAMPSIZE)		// wrapping the insert index
+	{
+		sen->insert = FALSE;
+		sen->avgRdy = TRUE;
+	}
+	switch(sen->mode)
+	{
+		case FILTER_EWMA:
+			if(!sen->avgRdy && sen->insert == 1)
+			{
+				sen->ewma = (long)sample<<EWMASHIFT;	// seeding with the first sample
+			}
+			sen->ewma += sample - (sen->ewma>>EWMASHIFT);
+			return sen->ewma>>EWMASHIFT;
+
+		case FILTER_MEDIAN:
+			return medianOf(sen);
+
+		default:
+			return sen->sum/SAMPSIZE;
+	}
+}//filterSample::
 
 /*>>> setADC: ===========================================================*/
 /*Author:	Dhruv Satasiya
@@ -440,51 +652,37 @@ void setADC()
 Author:		Shubham
 Date:		06/07/2024
 Modified:	None
-Desc:		This function calculates the temperature by taking samples and converting it into volatge value.
+Desc:		This function converts each completed sample window of the temperature
+		channel into degrees and keeps the safe locked while it is too hot.
 Input: 		none
 Returns:	None
  ============================================================================*/
 void tempControl(void)
 {
 	/*All the local variables to calculate the temperature*/
-	float volts = FALSE;
-	int average = FALSE;
 	float value = FALSE;
-	char sampCount = FALSE;
-	long sum = FALSE;
-	char flag = FALSE;
-	char index = FALSE;
+	sensor_t filtered = FALSE;
 
 	while(TRUE)
 	{
-		volts =	getADCSample(3);	// Getting samples from chan 3(Temp sensor)
-		value = (float)volts*ADCRES;	// converting the result into voltage
-		samplesArr[sampCount] = ((float)value/ TEMPM)-2; 
-		sampCount++;
-		if(sampCount>=SAMPSIZE)		// resetting the sampCount
+		if(adcRings[0].ready)		// a new window from the ADC interrupt
 		{
-			sampCount = FALSE;
-			flag = TRUE;		
-		}
-		if(flag)			// getting an average
-		{
-			for(index = FALSE;index<SAMPSIZE;index++)
-			{
-				sum += samplesArr[index];
-			}
-			average = sum/SAMPSIZE;
-			sum = FALSE;
-			if(average > 21)
+			filtered = filterSample(&sensors, getWindowAvg(0));
+			if(sensors.avgRdy)
 			{
-				TEMP_INDICATION = TRUE;
-				tempAlert();
+				value = (float)filtered*ADCRES;	// converting the result into voltage
+				tempAvg = ((float)value/ TEMPM)-2;
 			}
-			if(average<=21)
-			{
-				TEMP_INDICATION = FALSE;
-				break;			
-			}
-			
+		}
+		if(tempAvg > TEMPLIMIT)
+		{
+			TEMP_INDICATION = TRUE;
+			tempAlert();
+		}
+		else
+		{
+			TEMP_INDICATION = FALSE;
+			break;			
 		}
 	}		
 }//tempControl::
@@ -499,41 +697,22 @@ Returns:	None
 ============================================================================*/
 void keyPad()
 {	
-	char count = 0;
 	char correct[]={"Correct Password"};	// Correct password message
 	char wrong[]={" Wrong Password"};	// Wrong password message
 	char unlock[]={"Safe Unlocked "};	// Safe unlocking message
-	SetDDRamAddr(0x40);			// This function is used to keep or set the 
-	Delay1KTCYx(10);
 
 	if(passFlag)
 	{	
-		while(wrong[count] != '\0')	
-		{
-			WriteDataXLCD(wrong[count]);
-			count++;
-			Delay10KTCYx(50);
-		}
-		Delay10KTCYx(20);
-	
-		while(BusyXLCD());
-		WriteCmdXLCD(0x01);             // Clear display
-		Delay10KTCYx(20);
+		lcdPuts(0x40, wrong);
+		lcdFlush();
+		holdDisplay(MSGHOLD);
 
 		sprintf(trials, "Trials Left: %d", trialCount);		// Continuously updating the trials
 
-		SetDDRamAddr(0x81);		// This function is used to keep or set the 
-						// cursor at particular location.
-		Delay10KTCYx(20);
-		Delay10KTCYx(20);
-		while(trials[trialsIndex] != '\0')
-		{
-			WriteDataXLCD(trials[trialsIndex]);
-			trialsIndex++;
-			Delay10KTCYx(50);
-		}
-		trialsIndex = 0;
-		Delay10KTCYx(200);
+		lcdClear();
+		lcdPuts(0x81, trials);
+		lcdFlush();
+		holdDisplay(MSGHOLD);
 		
 		LOCK=FALSE;
 		SECONDARY=FALSE;
@@ -546,35 +725,22 @@ void keyPad()
 	else
 	{
 		trialCount = TOTAL_TRIALS;
-		while(correct[count] != '\0')
-		{
-			WriteDataXLCD(correct[count]);
-			count++;
-			Delay10KTCYx(50);
-			Delay10KTCYx(20);
-		}
-		while(BusyXLCD());	
-		WriteCmdXLCD(0x01);             // Clear display
-		Delay10KTCYx(250);
-		SetDDRamAddr(0x82);		// This function is used to keep or set the 									// cursor at particular location.
-		Delay10KTCYx(50);
-		count = 0;
-		while(unlock[count] != '\0')
-		{
-			WriteDataXLCD(unlock[count]);
-			count++;
-			Delay10KTCYx(100);
-			LOCK=TRUE;		
-		}	
-		while(BusyXLCD());
+		lcdPuts(0x40, correct);
+		lcdFlush();
+		holdDisplay(MSGHOLD);
+		lcdClear();
+		lcdPuts(0x82, unlock);
+		LOCK=TRUE;
+		lcdFlush();
+		holdDisplay(MSGHOLD);
 		if(!passFlag)
 		{
 			SECONDARY = TRUE;
 		}
 				           	 // safe unlocked...
 	}	
-	WriteCmdXLCD(0x01);             	// Clear display
-	Delay10KTCYx(20);
+	lcdClear();
+	lcdFlush();
 	
 }//keyPad::
 
@@ -703,18 +869,8 @@ void userLogIn(void)
 	{	
 		char message[]={"Enter Password"};
 		//char trialCount = 2;
-		char i= 0;			
-		SetDDRamAddr(0x81);		// This function is used to keep or set the 
-						// cursor at particular location.
-		Delay10KTCYx(20);
-		Delay10KTCYx(20);
-		while(message[i] != '\0')
-		{
-			WriteDataXLCD(message[i]);
-			i++;
-			Delay10KTCYx(50);
-		}
-		Delay10KTCYx(20);
+		lcdPuts(0x81, message);
+		lcdFlush();
 		
 		/*.....Main Algorithm to get the user password 
 			Let the user enter the password....*/	
@@ -783,11 +939,11 @@ void systemInit()
 	configTMR0(PSC_VALUE);
 	setOsc();
 	setADC();
-
-	for(index = 0; index<SAMPSIZE; index++)		// for loop to initalize array
-	{
-		samplesArr[index]= FALSE;
-	} 
+	initSensorCh(&sensors, TEMPFILTER);
+	configTMR2();			// 10ms ADC scan tick
+	configTMR6();			// 100us LCD transfer period
+	configINTS();
+	configPwrMgmt(TICKCYCLES, DUTYTICKS);	// Timer1 cycle counts, idling between interrupts
 }//eo systemInit
 
 /*--- MAIN: FUNCTION ----------------------------------------------------------
@@ -809,6 +965,7 @@ void main( void )
 	char count = FALSE;
 	char pbMask = 0x10;
 	char index = FALSE;	
+	char lcdOn = FALSE;		// TRUE once lcdOpen has run for this SYSON period
 	SECONDARY = FALSE;
 	TEMP_INDICATION = FALSE;
 	
@@ -841,17 +998,26 @@ void main( void )
 		}
 
 		tempControl();
+		if(SYSON && !lcdOn)		// opening the LCD once, on the SYSON edge
+		{
+			lcdOpen();
+			lcdOn = TRUE;
+		}
+		else if(!SYSON)
+		{
+			lcdOn = FALSE;
+		}
 		if(SYSON)
 		{
-			OpenXLCD(EIGHT_BIT & LINES_5X7);
-			SetDDRamAddr(0x83);
-			Delay10KTCYx(20);
 			introMessage(display,shiftMessage);
-			Delay10KTCYx(5);
 			userLogIn();
 			userMode(line1,line2);
-			Delay10KTCYx(5);
 			userLogIn();
-		}			
+		}
+		updateDuty();
+		if(!SYSON)			// display off, nothing to do until the next tick
+		{
+			idleUntilWake();
+		}
 	}
 } // eo main::